@@ -0,0 +1,247 @@
+// native benchmark of the C++ core, without python.
+//
+//   bencode_bench [--huge-mb N] [--save FILE] [--compare FILE] [--fixture FILE]
+//
+// --save writes MB/s of each case to FILE, --compare prints change against a saved FILE.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core.h"
+
+// each case runs at least this long and this many times
+#define minBenchSeconds 0.5
+#define minBenchRounds 3
+
+struct Corpus {
+    std::string name;
+    std::string data;
+};
+
+struct Result {
+    std::string name;
+    double mbps;
+    double ops;
+};
+
+// visitor doing nothing, to measure parsing alone
+struct NullVisitor {
+    size_t events = 0;
+
+    void onInt(long long) { events++; }
+    void onBigInt(std::string_view) { events++; }
+    void onBytes(std::string_view) { events++; }
+    void onKey(std::string_view) { events++; }
+    void onListBegin() { events++; }
+    void onDictBegin() { events++; }
+    void onEnd() { events++; }
+};
+
+static std::string randomBytes(std::mt19937_64 &rng, size_t n) {
+    std::string s(n, '\0');
+    for (auto &c : s) {
+        c = (char)rng();
+    }
+    return s;
+}
+
+static void writeBytes(Context &ctx, std::string_view s) {
+    ctx.writeSize_t(s.size());
+    ctx.writeChar(':');
+    ctx.write(s.data(), s.size());
+}
+
+static std::string krpcGetPeers() {
+    std::mt19937_64 rng(0);
+    ValueList values;
+    for (int i = 0; i < 50; i++) {
+        values.push_back(randomBytes(rng, 6));
+    }
+
+    Value v(ValueDict{
+        {"r", Value(ValueDict{{"id", randomBytes(rng, 20)},
+                              {"nodes", randomBytes(rng, 26 * 8)},
+                              {"token", randomBytes(rng, 8)},
+                              {"values", Value(std::move(values))}})},
+        {"t", "aa"},
+        {"y", "r"},
+    });
+
+    return v.encode();
+}
+
+// multi-file torrent, about half of it is file list and half is piece hashes
+static std::string hugeTorrent(size_t mb) {
+    std::mt19937_64 rng(0);
+    size_t size = mb * 1000 * 1000;
+
+    Context ctx(size + 4096);
+    ctx.write(std::string("d8:announce36:https://tracker.example.com/announce4:infod5:filesl"));
+    for (size_t i = 0; i < size / 2 / 50; i++) {
+        ctx.write(std::string("d6:lengthi"));
+        ctx.writeLongLong((long long)(rng() >> 24) + 1);
+        ctx.write(std::string("e4:pathl3:dir"));
+        writeBytes(ctx, "file-" + std::to_string(i) + ".bin");
+        ctx.write(std::string("ee"));
+    }
+    ctx.write(std::string("e4:name4:huge12:piece lengthi262144e6:pieces"));
+    writeBytes(ctx, randomBytes(rng, size / 2 / 20 * 20));
+    ctx.write(std::string("ee"));
+
+    return std::string(ctx.buf, ctx.index);
+}
+
+static std::string deep(size_t depth) {
+    return std::string(depth, 'l') + "i1e" + std::string(depth, 'e');
+}
+
+static std::string bigInts(size_t n) {
+    std::mt19937_64 rng(0);
+    Context ctx;
+    ctx.writeChar('l');
+    for (size_t i = 0; i < n; i++) {
+        ctx.writeChar('i');
+        if (rng() & 1) {
+            ctx.writeChar('-');
+        }
+        ctx.writeChar((char)('1' + rng() % 9));
+        size_t digits = 20 + rng() % 58;
+        for (size_t j = 0; j < digits; j++) {
+            ctx.writeChar((char)('0' + rng() % 10));
+        }
+        ctx.writeChar('e');
+    }
+    ctx.writeChar('e');
+
+    return std::string(ctx.buf, ctx.index);
+}
+
+static std::string readFile(const char *path) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+        fprintf(stderr, "failed to read %s\n", path);
+        exit(1);
+    }
+
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+template <typename F> static Result bench(const std::string &name, size_t size, F fn) {
+    using clock = std::chrono::steady_clock;
+
+    size_t rounds = 0;
+    auto start = clock::now();
+    double elapsed = 0;
+    while (rounds < minBenchRounds || elapsed < minBenchSeconds) {
+        fn();
+        rounds++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    double ops = rounds / elapsed;
+    return Result{name, size * ops / 1e6, ops};
+}
+
+static std::map<std::string, double> loadBaseline(const char *path) {
+    std::map<std::string, double> m;
+    std::ifstream f(path);
+    std::string name;
+    double mbps;
+    while (f >> name >> mbps) {
+        m[name] = mbps;
+    }
+
+    return m;
+}
+
+int main(int argc, char **argv) {
+    const char *fixture = "tests/fixtures/ubuntu-22.04.2-desktop-amd64.iso.torrent.bin";
+    const char *save = nullptr;
+    const char *compare = nullptr;
+    size_t hugeMb = 100;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--huge-mb") == 0) {
+            hugeMb = strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--save") == 0) {
+            save = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--compare") == 0) {
+            compare = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--fixture") == 0) {
+            fixture = argv[++i];
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--huge-mb N] [--save FILE] [--compare FILE] [--fixture FILE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Corpus> corpus = {
+        {"krpc_ping", "d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe"},
+        {"krpc_get_peers", krpcGetPeers()},
+        {"torrent", readFile(fixture)},
+        {"deep", deep(500)},
+        {"big_ints", bigInts(10000)},
+    };
+
+    if (hugeMb != 0) {
+        corpus.push_back(Corpus{"huge_torrent", hugeTorrent(hugeMb)});
+    }
+
+    std::vector<Result> results;
+    for (const auto &c : corpus) {
+        std::string_view data = c.data;
+        Value v = Value::decode(data);
+
+        results.push_back(bench(c.name + "/decode", data.size(), [&] { Value::decode(data); }));
+        results.push_back(bench(c.name + "/sax", data.size(), [&] {
+            NullVisitor n;
+            saxParse(data, n);
+        }));
+        results.push_back(bench(c.name + "/tape", data.size(), [&] {
+            Tape t;
+            t.build(data.data(), data.size());
+        }));
+        results.push_back(bench(c.name + "/encode", data.size(), [&] { v.encode(); }));
+    }
+
+    std::map<std::string, double> baseline;
+    if (compare != nullptr) {
+        baseline = loadBaseline(compare);
+    }
+
+    printf("%-28s %12s %14s", "case", "MB/s", "ops/s");
+    if (compare != nullptr) {
+        printf(" %10s", "change");
+    }
+    printf("\n");
+
+    for (const auto &r : results) {
+        printf("%-28s %12.2f %14.1f", r.name.c_str(), r.mbps, r.ops);
+        auto it = baseline.find(r.name);
+        if (it != baseline.end()) {
+            printf(" %+9.1f%%", (r.mbps / it->second - 1) * 100);
+        }
+        printf("\n");
+    }
+
+    if (save != nullptr) {
+        std::ofstream f(save);
+        for (const auto &r : results) {
+            f << r.name << " " << r.mbps << "\n";
+        }
+    }
+
+    return 0;
+}
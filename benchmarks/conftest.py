@@ -0,0 +1,27 @@
+from __future__ import annotations
+
+from typing import Any, Callable
+
+import pytest
+
+from corpus import all_corpus
+
+corpus = all_corpus()
+
+
+@pytest.fixture(params=sorted(corpus))
+def raw(request) -> bytes:
+    return corpus[request.param]
+
+
+@pytest.fixture
+def throughput(benchmark) -> Callable[..., Any]:
+    """run `fn(arg)` with pytest-benchmark and report MB/s of `size` bytes"""
+
+    def run(fn: Callable[[Any], Any], arg: Any, size: int) -> Any:
+        result = benchmark(fn, arg)
+        benchmark.extra_info["bytes"] = size
+        benchmark.extra_info["MB/s"] = round(size / benchmark.stats.stats.mean / 1e6, 2)
+        return result
+
+    return run
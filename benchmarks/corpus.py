@@ -0,0 +1,92 @@
+"""inputs for benchmarks, generated with fixed seed so results are comparable between runs."""
+
+from __future__ import annotations
+
+import os
+import random
+from pathlib import Path
+
+from bencode_cpp import bencode
+
+fixture = (
+    Path(__file__)
+    .joinpath("../../tests/fixtures/ubuntu-22.04.2-desktop-amd64.iso.torrent.bin")
+    .resolve()
+)
+
+# size of synthetic huge torrent, set to 0 to skip it
+huge_torrent_mb = int(os.environ.get("BENCODE_BENCH_HUGE_MB", "100"))
+
+
+def _bytes(r: random.Random, n: int) -> bytes:
+    return r.getrandbits(n * 8).to_bytes(n, "little")
+
+
+def krpc_ping() -> bytes:
+    return b"d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe"
+
+
+def krpc_get_peers() -> bytes:
+    r = random.Random(0)
+    return bencode(
+        {
+            "r": {
+                "id": _bytes(r, 20),
+                "token": _bytes(r, 8),
+                "values": [_bytes(r, 6) for _ in range(50)],
+                "nodes": _bytes(r, 26 * 8),
+            },
+            "t": b"aa",
+            "y": b"r",
+        }
+    )
+
+
+def torrent() -> bytes:
+    return fixture.read_bytes()
+
+
+def huge_torrent(size_mb: int) -> bytes:
+    """multi-file torrent, about half of it is file list and half is piece hashes"""
+    r = random.Random(0)
+    size = size_mb * 1000 * 1000
+    files = [
+        {"length": r.randint(1, 1 << 40), "path": [b"dir", b"file-%d.bin" % i]}
+        for i in range(size // 2 // 50)
+    ]
+
+    return bencode(
+        {
+            "announce": "https://tracker.example.com/announce",
+            "info": {
+                "files": files,
+                "name": "huge",
+                "piece length": 1 << 18,
+                "pieces": _bytes(r, size // 2 // 20 * 20),
+            },
+        }
+    )
+
+
+def deep(depth: int = 500) -> bytes:
+    return b"l" * depth + b"i1e" + b"e" * depth
+
+
+def big_ints(n: int = 10000) -> bytes:
+    r = random.Random(0)
+    return bencode([r.randint(1 << 64, 1 << 256) * r.choice([1, -1]) for _ in range(n)])
+
+
+def all_corpus() -> dict[str, bytes]:
+    c = {
+        "krpc_ping": krpc_ping(),
+        "krpc_get_peers": krpc_get_peers(),
+        "torrent": torrent(),
+        "deep": deep(),
+        "big_ints": big_ints(),
+    }
+
+    if huge_torrent_mb:
+        c["huge_torrent"] = huge_torrent(huge_torrent_mb)
+
+    return c
@@ -0,0 +1,22 @@
+import pytest
+
+from bencode_cpp import bdecode, bdecode_lazy, bdecode_many
+
+# larger input is only benchmarked alone
+batch_max_size = 1000 * 1000
+
+
+def test_bdecode(throughput, raw: bytes):
+    throughput(bdecode, raw, len(raw))
+
+
+def test_bdecode_lazy(throughput, raw: bytes):
+    throughput(bdecode_lazy, raw, len(raw))
+
+
+def test_bdecode_many(throughput, raw: bytes):
+    if len(raw) > batch_max_size:
+        pytest.skip("batch of large input takes too much memory")
+
+    batch = [raw] * 64
+    throughput(bdecode_many, batch, len(raw) * len(batch))
@@ -0,0 +1,18 @@
+import pytest
+
+from bencode_cpp import bdecode, bencode, bencode_many
+
+# larger input is only benchmarked alone
+batch_max_size = 1000 * 1000
+
+
+def test_bencode(throughput, raw: bytes):
+    throughput(bencode, bdecode(raw), len(raw))
+
+
+def test_bencode_many(throughput, raw: bytes):
+    if len(raw) > batch_max_size:
+        pytest.skip("batch of large input takes too much memory")
+
+    batch = [bdecode(raw)] * 64
+    throughput(bencode_many, batch, len(raw) * len(batch))
@@ -10,6 +10,8 @@ macro = [("FMT_HEADER_ONLY", "")]
 extra_compile_args = None
 # if os.environ.get("BENCODE_CPP_DEBUG") == "1":
 # macro.append(("BENCODE_CPP_DEBUG", "1"))
+if os.environ.get("BENCODE_CPP_STATS") == "1":
+    macro.append(("BENCODE_CPP_STATS", "1"))
 if sys.platform == "win32":
     extra_compile_args = ["/utf-8"]
 
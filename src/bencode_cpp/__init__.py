@@ -1,13 +1,55 @@
 from ._bencode import (
     bdecode,
+    bdecode_file,
+    bdecode_lazy,
+    bdecode_many,
+    bdecode_path,
+    bdecode_paths,
     bencode,
+    bencode_into,
+    bencode_many,
+    bencode_to,
+    bencoded_size,
+    bvalidate,
+    configure_pool,
+    info_hash,
+    intern_keys,
+    raw_value,
+    reset_stats,
+    stats,
+    BencodeRaw,
+    Decoder,
+    LazyDict,
+    LazyList,
+    Schema,
     BencodeDecodeError,
     BencodeEncodeError,
 )
 
 __all__ = [
     "bdecode",
+    "bdecode_file",
+    "bdecode_lazy",
+    "bdecode_many",
+    "bdecode_path",
+    "bdecode_paths",
     "bencode",
+    "bencode_into",
+    "bencode_many",
+    "bencode_to",
+    "bencoded_size",
+    "bvalidate",
+    "configure_pool",
+    "info_hash",
+    "intern_keys",
+    "raw_value",
+    "reset_stats",
+    "stats",
+    "BencodeRaw",
+    "Decoder",
+    "LazyDict",
+    "LazyList",
+    "Schema",
     "BencodeDecodeError",
     "BencodeEncodeError",
 ]
@@ -1,7 +1,143 @@
-from typing import Any
+import os
+from mmap import mmap
+from typing import Any, Iterable, Iterator, Optional, Protocol, Sequence, Union
 
-def bdecode(b: bytes, /) -> Any: ...
-def bencode(v: Any, /) -> bytes: ...
+_Buffer = Union[bytes, bytearray, memoryview, mmap]
+_Path = Union[str, bytes, os.PathLike[str], os.PathLike[bytes]]
+
+class _Writer(Protocol):
+    def write(self, b: bytes, /) -> Any: ...
+
+def bdecode(
+    b: _Buffer,
+    /,
+    *,
+    strict: bool = True,
+    max_depth: int = 1000,
+    raw_keys: Optional[Iterable[Union[bytes, str]]] = None,
+) -> Any:
+    """decode bencode data.
+
+    values of dict keys in ``raw_keys`` are returned as :class:`BencodeRaw` without decoding,
+    keys match in dicts at any depth. they are validated with same ``strict`` option.
+    """
+def bdecode_file(
+    path: _Path,
+    /,
+    *,
+    strict: bool = True,
+    max_depth: int = 1000,
+    raw_keys: Optional[Iterable[Union[bytes, str]]] = None,
+) -> Any: ...
+def bdecode_lazy(b: _Buffer, /) -> Any: ...
+def bdecode_many(buffers: Sequence[_Buffer], workers: int = 0) -> list[Any]: ...
+def bdecode_path(
+    b: _Buffer, key_path: Sequence[Union[bytes, str, int]], *, max_depth: int = 1000
+) -> Any: ...
+def bdecode_paths(
+    b: _Buffer,
+    key_paths: Iterable[Sequence[Union[bytes, str, int]]],
+    default: Any = None,
+    *,
+    max_depth: int = 1000,
+) -> list[Any]: ...
+def bencode(v: Any, /, *, max_depth: int = 1000, exact_size: bool = False) -> bytes:
+    """encode `v` to bencode bytes.
+
+    with ``exact_size=True`` encoded size is computed first and data is written directly into
+    the result, it's faster for large values with large bytes and str.
+    """
+def bencode_into(
+    v: Any,
+    buffer: Union[bytearray, memoryview, mmap],
+    offset: int = 0,
+    *,
+    max_depth: int = 1000,
+) -> int: ...
+def bencode_many(values: Sequence[Any]) -> list[Union[bytes, Exception]]: ...
+def bencoded_size(v: Any, /, *, max_depth: int = 1000) -> int: ...
+def bencode_to(
+    v: Any, file: Union[_Writer, int], buffer_size: int = 65536, *, max_depth: int = 1000
+) -> int: ...
+def configure_pool(
+    max_contexts: int = 5, initial_size: int = 4096, max_retained: int = 31457280
+) -> None:
+    """set limits of buffers reused by `bencode` in each thread.
+
+    at most ``max_contexts`` buffers are kept, buffers grown larger than ``max_retained`` bytes
+    are freed. new buffers start with ``initial_size`` bytes or larger to fit recent outputs,
+    and kept buffers much larger than recent outputs are shrunk.
+    ``initial_size`` must be in ``[64, max_retained]``.
+    """
+
+def raw_value(b: _Buffer, key_path: Sequence[Union[bytes, str, int]]) -> bytes: ...
+def info_hash(b: _Buffer, v2: bool = False) -> bytes: ...
+def bvalidate(b: _Buffer, /) -> Optional[int]:
+    """check `b` is exactly one valid bencode value with sorted unique dict keys.
+
+    return None if it's valid, or offset where invalid data is found, compare it with ``is None``.
+    python objects are not created and GIL is released while checking.
+    """
+
+def intern_keys(keys: Iterable[bytes]) -> None: ...
+def stats() -> dict[str, int]: ...
+def reset_stats() -> None: ...
+
+class Decoder:
+    """push decoder, values split between chunks are kept until completed.
+
+    if a chunk has invalid data after some completed values, ``feed`` returns them
+    and raises the error on next call.
+    """
+
+    def __init__(
+        self,
+        *,
+        max_depth: int = 1000,
+        max_int_length: int = 4300,
+        max_bytes_length: int = 104857600,
+    ) -> None: ...
+    def feed(self, b: _Buffer, /) -> list[Any]: ...
+    def reset(self) -> None: ...
+    @property
+    def pending(self) -> bool: ...
+
+class LazyList:
+    def __len__(self) -> int: ...
+    def __getitem__(self, index: int, /) -> Any: ...
+    def __iter__(self) -> Iterator[Any]: ...
+    def to_python(self) -> list[Any]: ...
+
+class LazyDict:
+    def __len__(self) -> int: ...
+    def __getitem__(self, key: bytes, /) -> Any: ...
+    def __contains__(self, key: object, /) -> bool: ...
+    def __iter__(self) -> Iterator[bytes]: ...
+    def get(self, key: bytes, default: Any = None) -> Any: ...
+    def keys(self) -> list[bytes]: ...
+    def values(self) -> list[Any]: ...
+    def items(self) -> list[tuple[bytes, Any]]: ...
+    def to_python(self) -> dict[bytes, Any]: ...
+
+class BencodeRaw:
+    """a bencoded value kept as encoded bytes, ``bencode`` writes it as is."""
+
+    def __init__(self, b: _Buffer) -> None: ...
+    def __bytes__(self) -> bytes: ...
+    def __len__(self) -> int: ...
+    def __hash__(self) -> int: ...
 
 class BencodeDecodeError(Exception): ...
 class BencodeEncodeError(Exception): ...
+
+class Schema:
+    """decode bencode into dataclass or TypedDict described by type hints.
+
+    field key defaults to field name, use ``field(metadata={"bencode_key": ...})`` to override.
+    str fields are decoded as UTF-8, keys not in schema are skipped.
+    nesting of schema types is limited to 1000 even with larger ``max_depth``, ``Any`` values
+    are only limited by ``max_depth``.
+    """
+
+    def __init__(self, tp: Any) -> None: ...
+    def decode(self, b: _Buffer, /, *, max_depth: int = 1000) -> Any: ...
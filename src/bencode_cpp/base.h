@@ -0,0 +1,70 @@
+#pragma once
+
+// python independent definitions shared by all headers of the core library.
+
+#include <cstdio>
+#include <exception>
+#include <string>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4996)
+#endif
+
+#ifdef BENCODE_CPP_DEBUG
+
+#ifdef _MSC_VER
+#define debug_print(fmt, ...)                                                                      \
+                                                                                                   \
+    do {                                                                                           \
+        printf(__FILE__);                                                                          \
+        printf(":");                                                                               \
+        printf("%d", __LINE__);                                                                    \
+        printf("\t%s", __FUNCTION__);                                                              \
+        printf("\tDEBUG: ");                                                                       \
+        printf(fmt, __VA_ARGS__);                                                                  \
+        printf("\n");                                                                              \
+    } while (0)
+
+#else
+
+#define debug_print(fmt, ...)                                                                      \
+    do {                                                                                           \
+        printf(__FILE__);                                                                          \
+        printf(":");                                                                               \
+        printf("%d", __LINE__);                                                                    \
+        printf("\t%s\tDEBUG: ", __PRETTY_FUNCTION__);                                              \
+        printf(fmt, ##__VA_ARGS__);                                                                \
+        printf("\n");                                                                              \
+    } while (0)
+
+#endif
+#else
+
+#define debug_print(fmt, ...)                                                                      \
+    do {                                                                                           \
+    } while (0)
+
+#endif
+
+// containers nested deeper than this are rejected when encoding and decoding
+#define defaultMaxDepth 1000
+
+struct EncodeError : public std::exception {
+public:
+    EncodeError(std::string msg) { s = msg; }
+
+    const char *what() const throw() { return s.c_str(); }
+
+private:
+    std::string s;
+};
+
+struct DecodeError : public std::exception {
+public:
+    DecodeError(std::string msg) { s = msg; }
+
+    const char *what() const throw() { return s.c_str(); }
+
+private:
+    std::string s;
+};
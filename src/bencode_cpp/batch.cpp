@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "ctx.h"
+#include "tape.h"
+
+namespace py = pybind11;
+
+extern py::object tapeToPython(const char *buf, const Tape &tape, uint32_t entry);
+
+extern void encodeValue(Context *ctx, py::handle obj);
+
+// at least this many items for each worker thread, small batch is not worth a thread.
+#define batchItemsPerWorker 32
+
+// take current python error as an exception object and clear it.
+static py::object fetchError() {
+    PyObject *type, *value, *tb;
+    PyErr_Fetch(&type, &value, &tb);
+    PyErr_NormalizeException(&type, &value, &tb);
+    if (tb != NULL) {
+        PyException_SetTraceback(value, tb);
+    }
+
+    Py_XDECREF(type);
+    Py_XDECREF(tb);
+
+    return py::reinterpret_steal<py::object>(value);
+}
+
+// a parallel loop shared by the caller and some pool threads.
+struct PoolJob {
+    std::function<void()> run;
+    // pool threads allowed to join this job
+    size_t helpers;
+    size_t started = 0;
+    size_t finished = 0;
+};
+
+// worker threads created on first use and reused by later batches.
+class WorkerPool {
+public:
+    // run `job.run` on caller thread and up to `job.helpers` pool threads, return when all of
+    // them are finished.
+    void run(PoolJob &job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            grow(job.helpers);
+            if (job.helpers != 0) {
+                queue.push_back(&job);
+            }
+        }
+        cond.notify_all();
+
+        std::exception_ptr error;
+        try {
+            job.run();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        // caller has done all the work, pool threads not started yet must not touch `job`
+        auto it = std::find(queue.begin(), queue.end(), &job);
+        if (it != queue.end()) {
+            queue.erase(it);
+        }
+        job.helpers = job.started;
+        done.wait(lock, [&job]() { return job.finished == job.started; });
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable done;
+    std::deque<PoolJob *> queue;
+    std::vector<std::thread> threads;
+
+    // start threads up to `n`, it's fine to have less if thread creation failed.
+    void grow(size_t n) {
+        while (threads.size() < n) {
+            try {
+                threads.emplace_back([this]() { loop(); });
+            } catch (std::system_error &) {
+                return;
+            }
+        }
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (1) {
+            cond.wait(lock, [this]() { return !queue.empty(); });
+
+            PoolJob *job = queue.front();
+            job->started++;
+            if (job->started == job->helpers) {
+                queue.pop_front();
+            }
+
+            lock.unlock();
+            job->run();
+            lock.lock();
+
+            job->finished++;
+            done.notify_all();
+        }
+    }
+};
+
+// never freed, threads are left blocked at process exit instead of being joined.
+static WorkerPool *workerPool = new WorkerPool();
+
+// run `fn(i)` for i in [0, n) on up to `workers` threads, caller thread is one of them.
+template <typename F> static void parallelFor(size_t n, size_t workers, F fn) {
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers = std::min(workers, std::max((size_t)1, n / batchItemsPerWorker));
+
+    std::atomic<size_t> next{0};
+    auto run = [&]() {
+        for (size_t i = next++; i < n; i = next++) {
+            fn(i);
+        }
+    };
+
+    if (workers == 1) {
+        run();
+        return;
+    }
+
+    PoolJob job{run, workers - 1};
+    workerPool->run(job);
+}
+
+struct DecodeItem {
+    Py_buffer view;
+    bool hasView = false;
+    Tape tape;
+    bool failed = false;
+    std::string error;
+
+    ~DecodeItem() {
+        if (hasView) {
+            PyBuffer_Release(&view);
+        }
+    }
+};
+
+py::list bdecode_many(py::object buffers, size_t workers) {
+    auto seq = py::reinterpret_steal<py::object>(
+        PySequence_Fast(buffers.ptr(), "bdecode_many() argument must be a sequence"));
+    if (!seq) {
+        throw py::error_already_set();
+    }
+
+    size_t n = PySequence_Fast_GET_SIZE(seq.ptr());
+    std::vector<DecodeItem> items(n);
+    py::list results(n);
+
+    for (size_t i = 0; i < n; i++) {
+        HPy b = PySequence_Fast_GET_ITEM(seq.ptr(), i);
+        if (PyObject_GetBuffer(b, &items[i].view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError, "can only decode bytes-like object");
+            results[i] = fetchError();
+            continue;
+        }
+
+        items[i].hasView = true;
+        statAdd(StatDecodeCalls, 1);
+        statAdd(StatBytesIn, items[i].view.len);
+    }
+
+    // validate and index all buffers without GIL
+    {
+        py::gil_scoped_release release;
+        parallelFor(n, workers, [&items](size_t i) {
+            DecodeItem &item = items[i];
+            if (!item.hasView) {
+                return;
+            }
+
+            try {
+                item.tape.build((const char *)item.view.buf, item.view.len);
+            } catch (DecodeError &e) {
+                item.failed = true;
+                item.error = e.what();
+            } catch (std::bad_alloc &) {
+                item.failed = true;
+                item.error = "failed to alloc memory";
+            }
+        });
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        DecodeItem &item = items[i];
+        if (!item.hasView) {
+            continue;
+        }
+
+        if (item.failed) {
+            PyErr_SetString(BencodeDecodeErrorType, item.error.c_str());
+            results[i] = fetchError();
+            continue;
+        }
+
+        // python objects may still fail, like int longer than `sys.get_int_max_str_digits()`
+        try {
+            results[i] = tapeToPython((const char *)item.view.buf, item.tape, 0);
+        } catch (py::error_already_set &e) {
+            e.restore();
+            results[i] = fetchError();
+        }
+
+        // free index memory as soon as possible
+        item.tape.entries = std::vector<TapeEntry>();
+    }
+
+    return results;
+}
+
+py::list bencode_many(py::object values) {
+    auto seq = py::reinterpret_steal<py::object>(
+        PySequence_Fast(values.ptr(), "bencode_many() argument must be a sequence"));
+    if (!seq) {
+        throw py::error_already_set();
+    }
+
+    size_t n = PySequence_Fast_GET_SIZE(seq.ptr());
+    py::list results(n);
+
+    // one context for the whole batch
+    auto ctx = std::make_unique<Context>();
+
+    for (size_t i = 0; i < n; i++) {
+        ctx->reset();
+
+        try {
+            encodeValue(ctx.get(), PySequence_Fast_GET_ITEM(seq.ptr(), i));
+            results[i] = py::bytes(ctx->buf, ctx->index);
+            continue;
+        } catch (EncodeError &e) {
+            PyErr_SetString(BencodeEncodeErrorType, e.what());
+        } catch (py::error_already_set &e) {
+            e.restore();
+        } catch (py::builtin_exception &e) {
+            e.set_error();
+        } catch (BufferAllocFailed &) {
+            // buffer is kept as it was when growing fails, later items can still use it
+            PyErr_NoMemory();
+        }
+
+        results[i] = fetchError();
+    }
+
+    return results;
+}
@@ -1,16 +1,93 @@
 #include <pybind11/pybind11.h>
 
 #include "common.h"
+#include "ctx.h"
 
 namespace py = pybind11;
 
-extern py::bytes bencode(py::object v);
+PyObject *BencodeDecodeErrorType;
+PyObject *BencodeEncodeErrorType;
 
-extern py::object bdecode(py::object b);
+extern py::bytes bencode(py::object v, size_t maxDepth, bool exactSize);
+
+extern size_t bencoded_size(py::object v, size_t maxDepth);
+
+extern size_t bencode_to(py::object v, py::object file, size_t bufferSize, size_t maxDepth);
+
+extern size_t bencode_into(py::object v, py::object buffer, Py_ssize_t offset,
+                           size_t maxDepth);
+
+extern py::object bdecode(py::object b, bool strict, size_t maxDepth, py::object rawKeys);
+
+extern py::object bdecode_file(py::object path, bool strict, size_t maxDepth,
+                               py::object rawKeys);
+
+extern py::object bdecode_lazy(py::object b);
+
+extern void registerLazyTypes(py::module_ &m);
+
+extern void registerDecoderType(py::module_ &m);
+
+extern void registerSchemaType(py::module_ &m);
+
+extern py::list bdecode_many(py::object buffers, size_t workers);
+
+extern py::list bencode_many(py::object values);
+
+extern py::bytes raw_value(py::object b, py::object keyPath);
+
+extern py::bytes info_hash(py::object b, bool v2);
+
+extern py::object bdecode_path(py::object b, py::object keyPath, size_t maxDepth);
+
+extern py::list bdecode_paths(py::object b, py::iterable keyPaths, py::object defaultValue,
+                              size_t maxDepth);
+
+extern py::object bvalidate(py::object b);
+
+extern void intern_keys(py::iterable keys);
+
+extern void configure_pool(size_t maxContexts, size_t initialSize, size_t maxRetained);
+
+extern void registerStats(py::module_ &m);
+
+extern void registerRawType(py::module_ &m);
 
 PYBIND11_MODULE(_bencode, m, py::mod_gil_not_used()) {
-    m.def("bdecode", &bdecode, "");
-    m.def("bencode", &bencode, "");
-    py::register_exception<DecodeError>(m, "BencodeDecodeError");
-    py::register_exception<EncodeError>(m, "BencodeEncodeError");
+    m.def("bdecode", &bdecode, "", py::arg("b"), py::pos_only(), py::kw_only(),
+          py::arg("strict") = true, py::arg("max_depth") = defaultMaxDepth,
+          py::arg("raw_keys") = py::none());
+    m.def("bdecode_file", &bdecode_file, "", py::arg("path"), py::pos_only(), py::kw_only(),
+          py::arg("strict") = true, py::arg("max_depth") = defaultMaxDepth,
+          py::arg("raw_keys") = py::none());
+    m.def("bdecode_lazy", &bdecode_lazy, "");
+    m.def("bencode", &bencode, "", py::arg("v"), py::pos_only(), py::kw_only(),
+          py::arg("max_depth") = defaultMaxDepth, py::arg("exact_size") = false);
+    m.def("bencoded_size", &bencoded_size, "", py::arg("v"), py::pos_only(), py::kw_only(),
+          py::arg("max_depth") = defaultMaxDepth);
+    m.def("bencode_to", &bencode_to, "", py::arg("v"), py::arg("file"),
+          py::arg("buffer_size") = 64 * 1024, py::kw_only(),
+          py::arg("max_depth") = defaultMaxDepth);
+    m.def("bencode_into", &bencode_into, "", py::arg("v"), py::arg("buffer"),
+          py::arg("offset") = 0, py::kw_only(), py::arg("max_depth") = defaultMaxDepth);
+    m.def("raw_value", &raw_value, "", py::arg("b"), py::arg("key_path"));
+    m.def("info_hash", &info_hash, "", py::arg("b"), py::arg("v2") = false);
+    m.def("bdecode_path", &bdecode_path, "", py::arg("b"), py::arg("key_path"), py::kw_only(),
+          py::arg("max_depth") = defaultMaxDepth);
+    m.def("bdecode_paths", &bdecode_paths, "", py::arg("b"), py::arg("key_paths"),
+          py::arg("default") = py::none(), py::kw_only(), py::arg("max_depth") = defaultMaxDepth);
+    m.def("bvalidate", &bvalidate, "", py::arg("b"), py::pos_only());
+    m.def("bdecode_many", &bdecode_many, "", py::arg("buffers"), py::arg("workers") = 0);
+    m.def("bencode_many", &bencode_many, "", py::arg("values"));
+    m.def("intern_keys", &intern_keys, "", py::arg("keys"));
+    m.def("configure_pool", &configure_pool, "", py::arg("max_contexts") = defaultPoolContexts,
+          py::arg("initial_size") = defaultBufferSize,
+          py::arg("max_retained") = defaultPoolMaxRetained);
+    BencodeDecodeErrorType = py::register_exception<DecodeError>(m, "BencodeDecodeError").ptr();
+    BencodeEncodeErrorType = py::register_exception<EncodeError>(m, "BencodeEncodeError").ptr();
+    registerLazyTypes(m);
+    registerDecoderType(m);
+    registerSchemaType(m);
+    registerStats(m);
+    registerRawType(m);
 }
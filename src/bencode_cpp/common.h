@@ -2,74 +2,88 @@
 
 #include <Python.h>
 
+#include <cstring>
+
+#include "base.h"
+#include "stats.h"
+
 #define HPy_ssize_t Py_ssize_t
 #define HPy PyObject *
 
-#ifdef _MSC_VER
-#pragma warning(disable : 4996)
-#endif
+// python exception types of DecodeError and EncodeError,
+// to build exception objects without throwing them.
+extern PyObject *BencodeDecodeErrorType;
+extern PyObject *BencodeEncodeErrorType;
 
-#ifdef BENCODE_CPP_DEBUG
-
-#ifdef _MSC_VER
-#define debug_print(fmt, ...)                                                                      \
-                                                                                                   \
-    do {                                                                                           \
-        printf(__FILE__);                                                                          \
-        printf(":");                                                                               \
-        printf("%d", __LINE__);                                                                    \
-        printf("\t%s", __FUNCTION__);                                                              \
-        printf("\tDEBUG: ");                                                                       \
-        printf(fmt, __VA_ARGS__);                                                                  \
-        printf("\n");                                                                              \
-    } while (0)
+class AutoFree {
+public:
+    PyObject *ptr;
 
-#else
+    AutoFree(PyObject *p) { ptr = p; }
 
-#define debug_print(fmt, ...)                                                                      \
-    do {                                                                                           \
-        printf(__FILE__);                                                                          \
-        printf(":");                                                                               \
-        printf("%d", __LINE__);                                                                    \
-        printf("\t%s\tDEBUG: ", __PRETTY_FUNCTION__);                                              \
-        printf(fmt, ##__VA_ARGS__);                                                                \
-        printf("\n");                                                                              \
-    } while (0)
+    ~AutoFree() { Py_DecRef(ptr); }
+};
 
-#endif
-#else
+// release a buffer from `PyObject_GetBuffer` when function return
+class AutoReleaseBuffer {
+public:
+    Py_buffer *view;
 
-#define debug_print(fmt, ...)                                                                      \
-    do {                                                                                           \
-    } while (0)
+    AutoReleaseBuffer(Py_buffer *v) { view = v; }
 
-#endif
+    ~AutoReleaseBuffer() { PyBuffer_Release(view); }
+};
 
-struct EncodeError : public std::exception {
+// lock `obj` while reading its items in free-threaded build, no-op with GIL.
+class CriticalSection {
 public:
-    EncodeError(std::string msg) { s = msg; }
+#ifdef Py_GIL_DISABLED
+    CriticalSection(HPy obj) { PyCriticalSection_Begin(&cs, obj); }
 
-    const char *what() const throw() { return s.c_str(); }
+    ~CriticalSection() { PyCriticalSection_End(&cs); }
 
 private:
-    std::string s;
+    PyCriticalSection cs;
+#else
+    CriticalSection(HPy) {}
+#endif
 };
 
-struct DecodeError : public std::exception {
-public:
-    DecodeError(std::string msg) { s = msg; }
+// default limits of encoder context pool of each thread
+#define defaultPoolContexts 5
+#define defaultPoolMaxRetained (30 * 1024 * 1024)
 
-    const char *what() const throw() { return s.c_str(); }
+// int tokens longer than this are rejected by streaming decoder,
+// same as default `sys.get_int_max_str_digits()` of python.
+#define defaultMaxIntLength 4300
 
-private:
-    std::string s;
-};
+// bytes longer than this are rejected by streaming decoder before their content is buffered
+#define defaultMaxBytesLength (100 * 1024 * 1024)
 
-class AutoFree {
-public:
-    PyObject *ptr;
+// ints up to this many digits are parsed from a stack copy
+#define stackDigitsSize 128
 
-    AutoFree(PyObject *p) { ptr = p; }
+// new reference of int from decimal digits like "-123", `s` doesn't need to be NUL terminated.
+static inline HPy longFromDigits(const char *s, size_t len) {
+    statAdd(StatDecodeBigInts, 1);
 
-    ~AutoFree() { Py_DecRef(ptr); }
-};
+    char stack[stackDigitsSize];
+    char *tmp = stack;
+    if (len >= stackDigitsSize) {
+        tmp = (char *)PyMem_Malloc(len + 1);
+        if (tmp == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+
+    memcpy(tmp, s, len);
+    tmp[len] = 0;
+
+    HPy i = PyLong_FromString(tmp, NULL, 10);
+
+    if (tmp != stack) {
+        PyMem_Free(tmp);
+    }
+
+    return i;
+}
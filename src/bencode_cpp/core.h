@@ -0,0 +1,55 @@
+#pragma once
+
+// header only C++ core of bencode-cpp, it doesn't depend on python.
+//
+//   Value v = Value::decode(buf);
+//   std::string out = v.encode();
+//
+// lower level building blocks:
+//   scan.h   validating scanners and path query over raw buffer
+//   sax.h    event based parser calling a visitor, without building a tree
+//   tape.h   flat structural index of a buffer
+//   ctx.h    growable output buffer for encoding
+//   sha.h    SHA-1/SHA-256 for info-hash
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base.h"
+#include "ctx.h"
+#include "mapped_file.h"
+#include "sax.h"
+#include "scan.h"
+#include "sha.h"
+#include "tape.h"
+#include "value.h"
+
+// raw value at `path` in `buf`, the whole buffer is validated.
+static inline std::optional<std::string_view> rawValue(std::string_view buf,
+                                                       const std::vector<PathItem> &path) {
+    size_t start, end;
+    if (!findPath(buf.data(), buf.size(), path, start, end)) {
+        return std::nullopt;
+    }
+
+    return buf.substr(start, end - start);
+}
+
+// SHA-1 (or SHA-256 for v2) digest of info dict of a torrent.
+static inline std::string infoHash(std::string_view torrent, bool v2 = false) {
+    auto info = rawValue(torrent, {PathItem{false, 0, "info"}});
+    if (!info.has_value() || info->front() != 'd') {
+        throw DecodeError("invalid torrent, missing info dict");
+    }
+
+    unsigned char digest[32];
+    if (v2) {
+        sha256(info->data(), info->size(), digest);
+        return std::string((const char *)digest, 32);
+    }
+
+    sha1(info->data(), info->size(), digest);
+    return std::string((const char *)digest, 20);
+}
@@ -1,15 +1,25 @@
 #pragma once
 #define FMT_HEADER_ONLY
 
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
 #include <string>
 #include <unordered_set>
 
 #include <fmt/core.h>
 
-#include "common.h"
+#include "base.h"
+#include "stats.h"
 
 #define defaultBufferSize 4096
 
+// decimal length of 64 bit integer, with sign
+#define maxIntegerLength 20
+
 class BufferAllocFailed : std::bad_alloc {
     const char *what() const throw() { return "failed to alloc member for buffer"; }
 };
@@ -22,20 +32,38 @@ public:
 
     std::unordered_set<uintptr_t> seen;
 
-    Context() {
-        buf = (char *)malloc(defaultBufferSize);
+    // if set, buffer is passed to sink and reused when it's full, instead of growing.
+    std::function<void(const char *, size_t)> sink;
+    // bytes already passed to sink
+    size_t flushed = 0;
+
+    Context() : Context(defaultBufferSize) {}
+
+    Context(size_t size) {
+        buf = (char *)malloc(size);
         if (buf == NULL) {
             throw BufferAllocFailed();
         }
 
         index = 0;
-        cap = defaultBufferSize;
+        cap = size;
+    }
+
+    // write into a buffer owned by caller, it will never be grown or freed.
+    // writes past the end are dropped but still counted in `index`.
+    Context(char *external, size_t size) {
+        buf = external;
+        index = 0;
+        cap = size;
+        owned = false;
     }
 
     ~Context() {
         debug_print("delete context");
         seen.clear();
-        free(buf);
+        if (owned) {
+            free(buf);
+        }
     }
 
     void reset() {
@@ -43,35 +71,105 @@ public:
         seen.clear();
     }
 
+    // release memory of an empty buffer larger than `size`, it's kept if realloc fails.
+    void shrink(size_t size) {
+        if (!owned || index != 0 || size >= cap) {
+            return;
+        }
+
+        char *tmp = (char *)realloc(buf, size);
+        if (tmp != NULL) {
+            buf = tmp;
+            cap = size;
+        }
+    }
+
     void write(std::string ss) { write(ss.data(), ss.size()); }
 
-    void write(const char *data, HPy_ssize_t size) {
-        bufferGrow(size);
+    void write(const char *data, size_t size) {
+        if (size + index + 1 >= cap && sink) {
+            flush();
+            // larger than the whole buffer, pass it to sink directly
+            if (size + 1 >= cap) {
+                sink(data, size);
+                flushed += size;
+                return;
+            }
+        }
 
-        std::memcpy(buf + index, data, size);
+        if (bufferGrow(size)) {
+            std::memcpy(buf + index, data, size);
+        }
 
         index = index + size;
     }
 
-    void writeSize_t(size_t val) { write(fmt::format("{}", val)); }
+    void writeSize_t(size_t val) { writeInteger(val); }
 
-    void writeLongLong(long long val) { write(fmt::format("{}", val)); }
+    void writeLongLong(long long val) { writeInteger(val); }
 
     void writeChar(const char c) {
-        bufferGrow(1);
-        buf[index] = c;
+        if (bufferGrow(1)) {
+            buf[index] = c;
+        }
+
         index = index + 1;
     }
 
+    void flush() {
+        if (index != 0) {
+            sink(buf, index);
+            flushed += index;
+            index = 0;
+        }
+    }
+
 private:
-    void bufferGrow(HPy_ssize_t size) {
+    bool owned = true;
+
+    // format digits in place, without a temporary string.
+    template <typename T> void writeInteger(T val) {
+        if (bufferGrow(maxIntegerLength)) {
+            index = std::to_chars(buf + index, buf + index + maxIntegerLength, val).ptr - buf;
+            return;
+        }
+
+        // caller's buffer doesn't have room for the longest number, this one may still fit
+        char tmp[maxIntegerLength];
+        char *end = std::to_chars(tmp, tmp + maxIntegerLength, val).ptr;
+        write(tmp, end - tmp);
+    }
+
+    // make sure there is room for `size` more bytes.
+    // return false if buffer is owned by caller and doesn't have enough space.
+    bool bufferGrow(size_t size) {
         if (size + index + 1 >= cap) {
-            char *tmp = (char *)realloc(buf, cap * 2 + size);
-            if (tmp == NULL) {
-                throw BufferAllocFailed();
+            return bufferGrowSlow(size);
+        }
+
+        return true;
+    }
+
+    bool bufferGrowSlow(size_t size) {
+        if (sink) {
+            flush();
+            if (size + 1 < cap) {
+                return true;
             }
-            cap = cap * 2 + size;
-            buf = tmp;
         }
+
+        if (!owned) {
+            return index + size <= cap;
+        }
+
+        statAdd(StatBufferGrows, 1);
+        char *tmp = (char *)realloc(buf, cap * 2 + size);
+        if (tmp == NULL) {
+            throw BufferAllocFailed();
+        }
+        cap = cap * 2 + size;
+        buf = tmp;
+
+        return true;
     }
 };
@@ -1,277 +1,331 @@
 #define FMT_HEADER_ONLY
 
 #include <string>
+#include <vector>
 
 #include <fmt/core.h>
 #include <pybind11/pybind11.h>
 
 #include "common.h"
-#include "overflow.h"
+#include "intern.h"
+#include "mapped_file.h"
+#include "raw.h"
+#include "scan.h"
 
 namespace py = pybind11;
 
-static py::object decodeAny(const char *buf, Py_ssize_t *index, Py_ssize_t size);
+// a list or dict being decoded
+struct DecodeFrame {
+    py::object container;
+    bool isDict;
+    // key of the dict value being decoded, unset when expecting next key
+    py::object key;
+    // raw data of last key, to check order of next key
+    const char *lastKey;
+    size_t lastKeyLen;
+};
+
+// state of one decoding call
+struct DecodeCtx {
+    KeyCache keys;
+    // validate order of dict keys, disabled for trusted data
+    bool strict = true;
+    size_t maxDepth = defaultMaxDepth;
+    // values of these dict keys are returned as BencodeRaw
+    std::vector<std::string> rawKeys;
+    // containers being decoded, from outermost to innermost
+    std::vector<DecodeFrame> stack;
+};
 
 #define decodeErrF(f, ...) throw DecodeError(fmt::format(f, ##__VA_ARGS__));
 
 static py::object decodeInt(const char *buf, Py_ssize_t *index, Py_ssize_t size) {
-    Py_ssize_t index_e = 0;
-    for (Py_ssize_t i = *index + 1; i < size; i++) {
-        if (buf[i] == 'e') {
-            index_e = i;
-            break;
-        }
-    }
-
-    if (index_e == 0) {
-        throw DecodeError(fmt::format("invalid int, missing 'e': %zd", *index));
-    }
-
-    // malformed 'ie'
-    if (*index + 1 == index_e) {
-        decodeErrF("invalid int, found 'ie': %zd", index_e);
-    }
-
-    int sign = 1;
-
     // i1234e
     // i-1234e
-    //  ^ index
-    *index = *index + 1;
+    //  ^ start
+    size_t start = *index + 1;
+    long long val;
+    bool fits;
+    size_t end = scanInt(buf, size, *index, val, fits);
 
-    if (buf[*index] == '-') {
-        if (buf[*index + 1] == '0') {
-            decodeErrF("invalid int, '-0' found at %zd", *index);
-        }
+    *index = end + 1;
 
-        sign = -1;
-    } else if (buf[*index] == '0') {
-        if (*index + 1 != index_e) {
-            decodeErrF("invalid int, non-zero int should not start with '0'. found at %zd", *index);
-        }
+    if (fits) {
+        return py::reinterpret_steal<py::object>(PyLong_FromLongLong(val));
     }
 
-    if (sign > 0) {
-        unsigned long long val = 0;
-        for (Py_ssize_t i = *index; i < index_e; i++) {
-            char c = buf[i] - '0';
-            if (c < 0 || c > 9) {
-                decodeErrF("invalid int, '%c' found at %zd", c, i);
-            }
+    // bencode int overflow i64, build a PyLong object from digits directly.
+    HPy i = longFromDigits(&buf[start], end - start);
+    if (i == NULL) {
+        throw py::error_already_set();
+    }
 
-            // val = val * 10 + (buf[i] - '0')
-            // but with overflow check
+    return py::reinterpret_steal<py::object>(i);
+}
 
-            int of = _u64_mul_overflow(val, 10, &val);
-            of = of || _u64_add_overflow(val, c, &val);
+// there is no bytes/Str in bencode, they only have 1 type for both of them.
+static py::bytes decodeBytes(const char *buf, Py_ssize_t *index, Py_ssize_t size) {
+    size_t end = *index;
+    size_t start = scanBytes(buf, size, end);
 
-            if (of) {
-                goto __OverFlow;
-            }
-        }
+    *index = end;
 
-        *index = index_e + 1;
+    return py::bytes(&buf[start], end - start);
+}
 
-        return py::cast(val);
-    } else {
-        long long val = 0;
-        int of;
-        for (Py_ssize_t i = *index + 1; i < index_e; i++) {
-            char c = buf[i] - '0';
-            if (c < 0 || c > 9) {
-                decodeErrF("invalid int, '{:c}' found at {}", c, i);
-            }
+// read a dict key into `top.key`, data at `index` must not be the end of dict.
+// return true if its value should be kept as BencodeRaw.
+static bool decodeKey(const char *buf, Py_ssize_t *index, Py_ssize_t size, DecodeCtx *ctx,
+                      DecodeFrame &top) {
+    if (!(buf[*index] >= '0' && buf[*index] <= '9')) {
+        decodeErrF("invalid dict, key must be bytes. index {}", *index);
+    }
 
-            of = _i64_mul_overflow(val, 10, &val);
-            of = of || _i64_add_overflow(val, c, &val);
+    size_t end = *index;
+    size_t start = scanBytes(buf, size, end);
+    const char *key = &buf[start];
+    size_t keyLen = end - start;
 
-            if (of) {
-                goto __OverFlow;
-            }
+    // check raw key before creating any object
+    if (ctx->strict && top.lastKey != NULL) {
+        int r = compareKey(top.lastKey, top.lastKeyLen, key, keyLen);
+        if (r > 0) {
+            decodeErrF("invalid dict, key not sorted. index {}", end);
         }
-
-        if (_i64_mul_overflow(val, sign, &val)) {
-            goto __OverFlow;
+        if (r == 0) {
+            std::string repr = py::repr(py::bytes(key, keyLen));
+            decodeErrF("invalid dict, find duplicated keys {}. index {}", repr, end);
         }
-
-        *index = index_e + 1;
-        return py::cast(val);
-    }
-
-    // i1234e
-    // i-1234e
-    //  ^ index
-
-    // bencode int overflow u64 or i64, build a PyLong object from Str directly.
-__OverFlow:;
-    const size_t n = index_e - *index + 1;
-    char *s = (char *)malloc(n);
-    if (s == NULL) {
-        throw std::bad_alloc();
     }
 
-    strncpy(s, &buf[*index], n);
-
-    *index = index_e + 1;
+    top.lastKey = key;
+    top.lastKeyLen = keyLen;
+    *index = end;
 
-    s[n - 1] = 0;
-
-    HPy i = PyLong_FromString(s, NULL, 10);
-
-    free(s);
+    HPy k = ctx->keys.get(key, keyLen);
+    if (k == NULL) {
+        throw py::error_already_set();
+    }
 
-    auto o = py::handle(i).cast<py::object>();
-    o.dec_ref();
-    return o;
-}
+    top.key = py::reinterpret_steal<py::object>(k);
 
-// there is no bytes/Str in bencode, they only have 1 type for both of them.
-static py::bytes decodeBytes(const char *buf, Py_ssize_t *index, Py_ssize_t size) {
-    Py_ssize_t index_sep = 0;
-    for (Py_ssize_t i = *index; i < size; i++) {
-        if (buf[i] == ':') {
-            index_sep = i;
-            break;
+    for (const auto &rawKey : ctx->rawKeys) {
+        if (rawKey == std::string_view(key, keyLen)) {
+            return true;
         }
     }
 
-    if (index_sep == 0) {
-        decodeErrF("invalid string, missing length: index %zd", *index);
-        return NULL;
-    }
+    return false;
+}
 
-    if (buf[*index] == '0' && *index + 1 != index_sep) {
-        decodeErrF("invalid bytes length, found at %zd", *index);
-        return NULL;
+// validate the value at `index` and keep it as encoded bytes
+static py::object decodeRaw(const char *buf, Py_ssize_t *index, Py_ssize_t size, bool strict) {
+    if (*index >= size) {
+        decodeErrF("invalid data, unexpected end of buffer. index {}", *index);
     }
 
-    Py_ssize_t len = 0;
-    for (Py_ssize_t i = *index; i < index_sep; i++) {
-        if (buf[i] < '0' || buf[i] > '9') {
-            decodeErrF("invalid bytes length, found '%c' at %zd", buf[i], i);
-            return NULL;
-        }
-        len = len * 10 + (buf[i] - '0');
+    if (buf[*index] == 'e') {
+        decodeErrF("invalid dict, missing value. index {}", *index);
     }
 
-    if (index_sep + len >= size) {
-        decodeErrF("bytes length overflow, index %zd", *index);
-        return NULL;
-    }
+    size_t start = *index;
+    size_t end = start;
+    skipValue(buf, size, end, strict);
 
-    *index = index_sep + len + 1;
+    *index = end;
 
-    return py::bytes(&buf[index_sep + 1], len);
+    return py::cast(BencodeRaw(py::bytes(&buf[start], end - start)));
 }
 
-static py::object decodeList(const char *buf, Py_ssize_t *index, Py_ssize_t size) {
-    *index = *index + 1;
-
-    py::list l = py::list(0);
+// decode without recursion, containers are kept in `ctx->stack` so hostile input like "llll..."
+// can't overflow C stack.
+static py::object decodeAny(const char *buf, Py_ssize_t *index, Py_ssize_t size,
+                            DecodeCtx *ctx) {
+    std::vector<DecodeFrame> &stack = ctx->stack;
+    stack.clear();
 
     while (1) {
-        if (buf[*index] == 'e') {
-            break;
-        }
-
-        py::object obj = decodeAny(buf, index, size);
-
-        l.append(obj);
-
+        // buffer may not be NUL terminated, never read past the end
         if (*index >= size) {
-            decodeErrF("invalid data, buffer overflow when decoding list. index {}", *index);
+            decodeErrF("invalid data, unexpected end of buffer. index {}", *index);
         }
-    }
 
-    *index = *index + 1;
+        char c = buf[*index];
+        py::object obj;
 
-    return l;
-}
+        if (!stack.empty() && c == 'e') {
+            if (stack.back().key) {
+                decodeErrF("invalid dict, missing value. index {}", *index);
+            }
 
-static py::object decodeDict(const char *buf, Py_ssize_t *index, Py_ssize_t size) {
-    *index = *index + 1;
-    std::optional<py::bytes> lastKey = std::nullopt;
+            *index = *index + 1;
+            obj = std::move(stack.back().container);
+            stack.pop_back();
+        } else if (!stack.empty() && stack.back().isDict && !stack.back().key) {
+            if (!decodeKey(buf, index, size, ctx, stack.back())) {
+                continue;
+            }
 
-    auto d = py::dict();
+            obj = decodeRaw(buf, index, size, ctx->strict);
+        } else if (c == 'i') {
+            obj = decodeInt(buf, index, size);
+        } else if (c >= '0' && c <= '9') {
+            obj = decodeBytes(buf, index, size);
+        } else if (c == 'l' || c == 'd') {
+            if (stack.size() >= ctx->maxDepth) {
+                decodeErrF("invalid data, nested too deep, max depth {}. index {}", ctx->maxDepth,
+                           *index);
+            }
 
-    while (1) {
-        if (buf[*index] == 'e') {
-            break;
+            *index = *index + 1;
+            py::object container = c == 'd' ? py::object(py::dict()) : py::object(py::list());
+            stack.push_back(DecodeFrame{std::move(container), c == 'd', py::object(), NULL, 0});
+            continue;
+        } else {
+            decodeErrF("invalid bencode prefix '{:c}', index {}", c, *index);
         }
 
-        auto key = decodeBytes(buf, index, size);
-        auto obj = decodeAny(buf, index, size);
+        if (stack.empty()) {
+            return obj;
+        }
 
-        debug_print("1");
-        // skip first key
-        if (lastKey.has_value()) {
-            debug_print("2");
-            if (key < lastKey.value()) {
-                decodeErrF("invalid dict, key not sorted. index {}", *index);
+        DecodeFrame &top = stack.back();
+        if (top.isDict) {
+            if (PyDict_SetItem(top.container.ptr(), top.key.ptr(), obj.ptr())) {
+                throw py::error_already_set();
             }
-            debug_print("3");
-            if (key.equal(lastKey.value())) {
-                std::string repr = py::repr(key);
-                decodeErrF("invalid dict, find duplicated keys {}. index {}", repr, *index);
+            top.key = py::object();
+        } else {
+            if (PyList_Append(top.container.ptr(), obj.ptr())) {
+                throw py::error_already_set();
             }
         }
-        debug_print("4");
-        lastKey = std::make_optional(key);
+    }
+}
 
-        if (*index >= size) {
-            decodeErrF("invalid data, buffer overflow end when decoding dict. index {}", *index);
+// decode one value at `index` and move `index` after it, for other decoders.
+py::object decodeValue(const char *buf, Py_ssize_t *index, Py_ssize_t size, size_t maxDepth) {
+    DecodeCtx ctx;
+    ctx.maxDepth = maxDepth;
+    return decodeAny(buf, index, size, &ctx);
+}
+
+// dict keys from `raw_keys` argument, bytes or str
+static std::vector<std::string> toRawKeys(py::handle rawKeys) {
+    std::vector<std::string> keys;
+    if (rawKeys.is_none()) {
+        return keys;
+    }
+
+    for (auto key : rawKeys) {
+        if (PyBytes_Check(key.ptr())) {
+            keys.emplace_back(PyBytes_AS_STRING(key.ptr()), PyBytes_GET_SIZE(key.ptr()));
+        } else if (PyUnicode_Check(key.ptr())) {
+            keys.push_back(key.cast<std::string>());
+        } else {
+            throw py::type_error("raw_keys must be bytes or str");
         }
+    }
+
+    return keys;
+}
 
-        d[key] = obj;
+static py::object decodeBuffer(const char *buf, Py_ssize_t size, bool strict, size_t maxDepth,
+                               std::vector<std::string> rawKeys) {
+    if (size == 0) {
+        throw DecodeError("can't decode empty bytes");
     }
 
-    *index = *index + 1;
+    statAdd(StatDecodeCalls, 1);
+    statAdd(StatBytesIn, size);
+
+    DecodeCtx ctx;
+    ctx.strict = strict;
+    ctx.maxDepth = maxDepth;
+    ctx.rawKeys = std::move(rawKeys);
+
+    Py_ssize_t index = 0;
+    py::object o = decodeAny(buf, &index, size, &ctx);
+
+    if (index != size) {
+        decodeErrF("invalid bencode data, parse end at index {} but total bytes length {}", index,
+                   size);
+    }
 
-    return d;
+    return o;
 }
 
-static py::object decodeAny(const char *buf, Py_ssize_t *index, Py_ssize_t size) {
-    // int
-    if (buf[*index] == 'i') {
-        return decodeInt(buf, index, size);
+py::object bdecode(py::object b, bool strict, size_t maxDepth, py::object rawKeys) {
+    std::vector<std::string> keys = toRawKeys(rawKeys);
+
+    // accept any object exporting a contiguous buffer (bytes, bytearray, memoryview, mmap...)
+    // and parse it in place, the buffer is held until decoding is done.
+    Py_buffer view;
+    if (PyObject_GetBuffer(b.ptr(), &view, PyBUF_SIMPLE)) {
+        PyErr_Clear();
+        throw py::type_error("can only decode bytes-like object");
     }
 
-    // bytes
-    if (buf[*index] >= '0' && buf[*index] <= '9') {
-        return decodeBytes(buf, index, size);
+    auto _ = AutoReleaseBuffer(&view);
+
+    return decodeBuffer((const char *)view.buf, view.len, strict, maxDepth, std::move(keys));
+}
+
+py::object bdecode_file(py::object path, bool strict, size_t maxDepth, py::object rawKeys) {
+    std::vector<std::string> keys = toRawKeys(rawKeys);
+
+    MappedFile f;
+    bool ok;
+
+#ifdef _WIN32
+    HPy s = NULL;
+    if (!PyUnicode_FSDecoder(path.ptr(), &s)) {
+        throw py::error_already_set();
     }
+    auto _0 = AutoFree(s);
 
-    // list
-    if (buf[*index] == 'l') {
-        return decodeList(buf, index, size);
+    wchar_t *p = PyUnicode_AsWideCharString(s, NULL);
+    if (p == NULL) {
+        throw py::error_already_set();
     }
 
-    // dict
-    if (buf[*index] == 'd') {
-        return decodeDict(buf, index, size);
+    {
+        py::gil_scoped_release release;
+        ok = f.open(p);
     }
 
-    decodeErrF("invalid bencode prefix '{:c}', index {}", buf[*index], *index);
-}
+    PyMem_Free(p);
 
-py::object bdecode(py::object b) {
-    if (!PyBytes_Check(b.ptr())) {
-        throw py::type_error("can only decode bytes");
+    if (!ok) {
+        PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, f.err, path.ptr());
+        throw py::error_already_set();
+    }
+#else
+    HPy b = NULL;
+    if (!PyUnicode_FSConverter(path.ptr(), &b)) {
+        throw py::error_already_set();
     }
+    auto _0 = AutoFree(b);
 
-    Py_ssize_t size = PyBytes_Size(b.ptr());
-    if (size == 0) {
-        throw DecodeError("can't decode empty bytes");
+    const char *p = PyBytes_AsString(b);
+
+    {
+        py::gil_scoped_release release;
+        ok = f.open(p);
     }
 
-    const char *buf = PyBytes_AsString(b.ptr());
+    if (!ok) {
+        errno = f.err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path.ptr());
+        throw py::error_already_set();
+    }
+#endif
 
-    Py_ssize_t index = 0;
-    py::object o = decodeAny(buf, &index, size);
+    py::object o = decodeBuffer(f.data, f.size, strict, maxDepth, std::move(keys));
 
-    if (index != size) {
-        decodeErrF("invalid bencode data, parse end at index {} but total bytes length {}", index,
-                   size);
+    {
+        py::gil_scoped_release release;
+        f.close();
     }
 
     return o;
@@ -0,0 +1,361 @@
+#define FMT_HEADER_ONLY
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "scan.h"
+
+namespace py = pybind11;
+
+#define decoderErrF(f, ...) throw DecodeError(fmt::format(f, ##__VA_ARGS__));
+
+// push decoder, keep parsing state across chunks so a value split between
+// network reads doesn't need to be parsed from the start again.
+class Decoder {
+public:
+    Decoder(size_t maxDepth, size_t maxIntLength, size_t maxBytesLength)
+        : maxDepth(maxDepth), maxIntLength(maxIntLength), maxBytesLength(maxBytesLength) {}
+
+    void reset() {
+        stack.clear();
+        state = StateValue;
+        token.clear();
+        content.clear();
+        remaining = 0;
+        offset = 0;
+        failed = false;
+        error = nullptr;
+    }
+
+    // if a value is partially decoded, or an error is not raised yet
+    bool pending() const { return state != StateValue || !stack.empty() || error; }
+
+    // feed next chunk of data, return values completed in it.
+    // if data is invalid after some completed values, they are returned and
+    // the error is raised by next call.
+    py::list feed(py::object b) {
+        if (failed) {
+            if (error) {
+                std::exception_ptr e = error;
+                error = nullptr;
+                std::rethrow_exception(e);
+            }
+
+            throw DecodeError("decoder failed on invalid data, reset it before feeding new data");
+        }
+
+        Py_buffer view;
+        if (PyObject_GetBuffer(b.ptr(), &view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            throw py::type_error("can only decode bytes-like object");
+        }
+        auto _ = AutoReleaseBuffer(&view);
+
+        statAdd(StatDecodeCalls, 1);
+        statAdd(StatBytesIn, view.len);
+
+        py::list out(0);
+
+        const char *buf = (const char *)view.buf;
+        size_t size = view.len;
+        size_t index = 0;
+
+        try {
+            while (index < size) {
+                switch (state) {
+                case StateValue:
+                    index = startValue(buf, index, out);
+                    break;
+                case StateInt:
+                    index = continueInt(buf, size, index, out);
+                    break;
+                case StateLength:
+                    index = continueLength(buf, size, index, out);
+                    break;
+                case StateBytes:
+                    index = continueBytes(buf, size, index, out);
+                    break;
+                }
+            }
+        } catch (...) {
+            // state is broken by any error, decoder can't be used until reset
+            failed = true;
+            if (out.size() == 0) {
+                throw;
+            }
+
+            error = std::current_exception();
+            return out;
+        }
+
+        offset += size;
+
+        return out;
+    }
+
+private:
+    enum State {
+        // waiting for the first byte of a value, or 'e' of a container
+        StateValue,
+        // in 'i...e'
+        StateInt,
+        // in length prefix of bytes
+        StateLength,
+        // in content of bytes
+        StateBytes,
+    };
+
+    struct Frame {
+        py::object container;
+        bool isDict;
+        py::object key;
+        py::object lastKey;
+    };
+
+    std::vector<Frame> stack;
+    State state = StateValue;
+    // digits of current int or bytes length
+    std::string token;
+    // partial content of bytes
+    std::string content;
+    size_t remaining = 0;
+    // total bytes fed before current chunk, for error message
+    size_t offset = 0;
+    bool failed = false;
+    // error after completed values in last chunk, raised by next `feed`
+    std::exception_ptr error;
+    size_t maxDepth;
+    size_t maxIntLength;
+    size_t maxBytesLength;
+
+    bool wantKey() const { return !stack.empty() && stack.back().isDict && !stack.back().key; }
+
+    size_t startValue(const char *buf, size_t index, py::list &out) {
+        char c = buf[index];
+
+        if (c == 'e' && !stack.empty()) {
+            if (stack.back().isDict && stack.back().key) {
+                decoderErrF("invalid dict, missing value. index {}", offset + index);
+            }
+
+            py::object done = std::move(stack.back().container);
+            stack.pop_back();
+            push(done, out, index);
+            return index + 1;
+        }
+
+        if (wantKey() && !(c >= '0' && c <= '9')) {
+            decoderErrF("invalid dict, key must be bytes. index {}", offset + index);
+        }
+
+        if (c == 'i') {
+            state = StateInt;
+            token.clear();
+            return index + 1;
+        }
+
+        if (c >= '0' && c <= '9') {
+            state = StateLength;
+            token.clear();
+            return index;
+        }
+
+        if ((c == 'l' || c == 'd') && stack.size() >= maxDepth) {
+            decoderErrF("invalid data, nested too deep, max depth {}. index {}", maxDepth,
+                        offset + index);
+        }
+
+        if (c == 'l') {
+            stack.push_back(Frame{py::list(0), false, py::object(), py::object()});
+            return index + 1;
+        }
+
+        if (c == 'd') {
+            stack.push_back(Frame{py::dict(), true, py::object(), py::object()});
+            return index + 1;
+        }
+
+        decoderErrF("invalid bencode prefix '{:c}', index {}", c, offset + index);
+    }
+
+    size_t continueInt(const char *buf, size_t size, size_t index, py::list &out) {
+        const char *p = (const char *)memchr(buf + index, 'e', size - index);
+        size_t end = p == NULL ? size : p - buf;
+
+        for (size_t i = index; i < end; i++) {
+            if (!((buf[i] >= '0' && buf[i] <= '9') ||
+                  (buf[i] == '-' && i == index && token.empty()))) {
+                decoderErrF("invalid int, '{:c}' found at {}", buf[i], offset + i);
+            }
+        }
+
+        if (token.size() + (end - index) > maxIntLength) {
+            decoderErrF("invalid int, longer than {} characters. index {}", maxIntLength,
+                        offset + index);
+        }
+
+        token.append(buf + index, end - index);
+        if (p == NULL) {
+            return size;
+        }
+
+        const char *s = token.data();
+        size_t len = token.size();
+        size_t digits = s[0] == '-' ? 1 : 0;
+
+        if (len == digits) {
+            decoderErrF("invalid int, no digits found at {}", offset + end);
+        }
+
+        if (s[digits] == '0' && (digits == 1 || len != 1)) {
+            decoderErrF("invalid int, leading '0' found at {}", offset + end - len + digits);
+        }
+
+        long long val;
+        py::object o;
+        if (std::from_chars(s, s + len, val).ec == std::errc()) {
+            o = py::reinterpret_steal<py::object>(PyLong_FromLongLong(val));
+        } else {
+            // out of long long range
+            HPy i = PyLong_FromString(token.c_str(), NULL, 10);
+            if (i == NULL) {
+                throw py::error_already_set();
+            }
+            o = py::reinterpret_steal<py::object>(i);
+        }
+
+        state = StateValue;
+        push(o, out, end);
+        return end + 1;
+    }
+
+    size_t continueLength(const char *buf, size_t size, size_t index, py::list &out) {
+        const char *p = (const char *)memchr(buf + index, ':', size - index);
+        size_t end = p == NULL ? size : p - buf;
+
+        for (size_t i = index; i < end; i++) {
+            if (buf[i] < '0' || buf[i] > '9') {
+                decoderErrF("invalid bytes length, found '{:c}' at {}", buf[i], offset + i);
+            }
+        }
+
+        token.append(buf + index, end - index);
+
+        // more than 2**60, something is wrong
+        if (token.size() > 18) {
+            decoderErrF("bytes length overflow, index {}", offset + end);
+        }
+
+        // reject a hostile length before any content is buffered, more digits only make it larger
+        size_t length = 0;
+        std::from_chars(token.data(), token.data() + token.size(), length);
+        if (length > maxBytesLength) {
+            decoderErrF("bytes length {} is larger than {}. index {}", length, maxBytesLength,
+                        offset + end - token.size());
+        }
+
+        if (p == NULL) {
+            return size;
+        }
+
+        if (token.empty()) {
+            decoderErrF("invalid string, missing length: index {}", offset + end);
+        }
+
+        if (token[0] == '0' && token.size() != 1) {
+            decoderErrF("invalid bytes length, found at {}", offset + end - token.size());
+        }
+
+        remaining = length;
+        content.clear();
+        index = end + 1;
+
+        // whole content in current chunk, build bytes directly from it
+        if (remaining <= size - index) {
+            state = StateValue;
+            push(py::bytes(buf + index, remaining), out, index);
+            return index + remaining;
+        }
+
+        state = StateBytes;
+        return index;
+    }
+
+    size_t continueBytes(const char *buf, size_t size, size_t index, py::list &out) {
+        size_t n = std::min(remaining, size - index);
+        content.append(buf + index, n);
+        remaining -= n;
+        index += n;
+
+        if (remaining == 0) {
+            state = StateValue;
+            push(py::bytes(content.data(), content.size()), out, index);
+            content.clear();
+            content.shrink_to_fit();
+        }
+
+        return index;
+    }
+
+    // a value is completed, put it into its parent container or output.
+    void push(py::object v, py::list &out, size_t index) {
+        if (stack.empty()) {
+            out.append(v);
+            return;
+        }
+
+        Frame &top = stack.back();
+
+        if (!top.isDict) {
+            if (PyList_Append(top.container.ptr(), v.ptr())) {
+                throw py::error_already_set();
+            }
+            return;
+        }
+
+        if (!top.key) {
+            if (top.lastKey) {
+                int r = compareKey(PyBytes_AS_STRING(top.lastKey.ptr()),
+                                   PyBytes_GET_SIZE(top.lastKey.ptr()), PyBytes_AS_STRING(v.ptr()),
+                                   PyBytes_GET_SIZE(v.ptr()));
+                if (r > 0) {
+                    decoderErrF("invalid dict, key not sorted. index {}", offset + index);
+                }
+                if (r == 0) {
+                    std::string repr = py::repr(v);
+                    decoderErrF("invalid dict, find duplicated keys {}. index {}", repr,
+                                offset + index);
+                }
+            }
+
+            top.key = v;
+            top.lastKey = v;
+            return;
+        }
+
+        if (PyDict_SetItem(top.container.ptr(), top.key.ptr(), v.ptr())) {
+            throw py::error_already_set();
+        }
+
+        top.key = py::object();
+    }
+};
+
+void registerDecoderType(py::module_ &m) {
+    py::class_<Decoder>(m, "Decoder")
+        .def(py::init<size_t, size_t, size_t>(), py::kw_only(),
+             py::arg("max_depth") = defaultMaxDepth,
+             py::arg("max_int_length") = defaultMaxIntLength,
+             py::arg("max_bytes_length") = defaultMaxBytesLength)
+        .def("feed", &Decoder::feed)
+        .def("reset", &Decoder::reset)
+        .def_property_readonly("pending", &Decoder::pending);
+}
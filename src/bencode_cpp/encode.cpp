@@ -1,127 +1,105 @@
 #include <Python.h>
 #include <algorithm> // std::sort
+#include <atomic>
+#include <cerrno>
+#include <string_view>
+#include <vector>
 #include <pybind11/pybind11.h>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "common.h"
 #include "ctx.h"
+#include "raw.h"
 
 namespace py = pybind11;
 
-static void encodeAny(Context *ctx, py::handle obj);
+struct DictItem {
+    // borrowed from `keyObj`, bytes content or cached utf-8 of str
+    std::string_view key;
+    py::object keyObj;
+    py::object value;
+};
 
-bool cmp(std::pair<std::string, py::handle> &a, std::pair<std::string, py::handle> &b) {
-    return a.first < b.first;
-}
+static std::string_view keyView(HPy key) {
+    if (PyBytes_Check(key)) {
+        return std::string_view(PyBytes_AS_STRING(key), PyBytes_GET_SIZE(key));
+    }
 
-static void encodeDict(Context *ctx, py::handle obj) {
-    debug_print("encodeDict");
-    ctx->writeChar('d');
-    auto l = PyDict_Size(obj.ptr());
-    if (l == 0) {
-        ctx->writeChar('e');
-        return;
+    HPy_ssize_t size;
+    const char *data = PyUnicode_AsUTF8AndSize(key, &size);
+    if (data == NULL) {
+        throw py::error_already_set();
     }
 
-    std::vector<std::pair<std::string, py::handle>> m(l);
-    auto items = PyDict_Items(obj.ptr());
+    return std::string_view(data, size);
+}
 
-    // smart pointer to dec_ref when function return
-    auto ref = AutoFree(items);
+static void addDictItem(std::vector<DictItem> &items, HPy key, HPy value) {
+    if (!(PyUnicode_Check(key) || PyBytes_Check(key))) {
+        throw EncodeError("dict keys must be str or bytes");
+    }
 
-    for (int i = 0; i < l; ++i) {
-        auto keyValue = PyList_GetItem(items, i);
-        auto key = PyTuple_GetItem(keyValue, 0);
-        auto value = PyTuple_GetItem(keyValue, 1);
+    items.push_back(DictItem{keyView(key), py::reinterpret_borrow<py::object>(key),
+                             py::reinterpret_borrow<py::object>(value)});
+}
 
-        if (!(PyUnicode_Check(key) || PyBytes_Check(key))) {
-            throw EncodeError("dict keys must be str or bytes");
+static void sortDictItems(std::vector<DictItem> &items) {
+    // dict decoded from bencode is already sorted, check it before sorting
+    bool sorted = true;
+    for (size_t i = 1; i < items.size(); i++) {
+        if (!(items[i - 1].key < items[i].key)) {
+            sorted = false;
+            break;
         }
+    }
 
-        debug_print("set items");
-        m.at(i) = std::make_pair(py::handle(key).cast<std::string>(), py::handle(value));
+    if (sorted) {
+        return;
     }
 
-    std::sort(m.begin(), m.end(), cmp);
-    auto lastKey = m[0].first;
-    debug_print("key '%s'\n", lastKey.data());
-    for (auto i = 1; i < l; i++) {
-        auto currentKey = m[i].first;
-        debug_print("key '%s'\n", currentKey.data());
-        if (currentKey == lastKey) {
-            throw EncodeError(fmt::format("found duplicated keys {}", lastKey));
-        }
+    std::sort(items.begin(), items.end(),
+              [](const DictItem &a, const DictItem &b) { return a.key < b.key; });
 
-        lastKey = currentKey;
+    for (size_t i = 1; i < items.size(); i++) {
+        if (items[i - 1].key == items[i].key) {
+            throw EncodeError(fmt::format("found duplicated keys {}", items[i].key));
+        }
     }
+}
 
-    for (auto pair : m) {
-        ctx->writeSize_t(pair.first.length());
-        ctx->writeChar(':');
-        ctx->write(pair.first.data(), pair.first.length());
+static void collectDict(py::handle obj, std::vector<DictItem> &items) {
+    debug_print("collectDict");
+    items.reserve(PyDict_Size(obj.ptr()));
 
-        encodeAny(ctx, pair.second);
-    }
+    CriticalSection _cs(obj.ptr());
 
-    ctx->writeChar('e');
-    return;
+    HPy_ssize_t pos = 0;
+    HPy key;
+    HPy value;
+    while (PyDict_Next(obj.ptr(), &pos, &key, &value)) {
+        addDictItem(items, key, value);
+    }
 }
 
 // slow path for types.MappingProxyType
-static void encodeDictLike(Context *ctx, py::handle h) {
-    debug_print("encodeDictLike");
-    ctx->writeChar('d');
-    debug_print("get object size");
-    auto l = PyObject_Size(h.ptr());
-    if (l == 0) {
-        ctx->writeChar('e');
-        return;
-    }
-
+static void collectDictLike(py::handle h, std::vector<DictItem> &items) {
+    debug_print("collectDictLike");
     auto obj = h.cast<py::object>();
 
-    std::vector<std::pair<std::string, py::handle>> m(l);
     debug_print("get items");
-    auto items = obj.attr("items")();
-
-    size_t index = 0;
-    for (auto keyValue : items) {
-        std::string repr = py::repr(keyValue);
-        debug_print("%s", repr.c_str());
-        auto key = PyTuple_GetItem(keyValue.ptr(), 0);
-        auto value = PyTuple_GetItem(keyValue.ptr(), 1);
-
-        if (!(PyUnicode_Check(key) || PyBytes_Check(key))) {
-            throw EncodeError("dict keys must be str or bytes");
-        }
-
-        debug_print("set items");
-        m.at(index) = std::make_pair(py::handle(key).cast<std::string>(), py::handle(value));
-        index++;
-    }
-
-    std::sort(m.begin(), m.end(), cmp);
-    auto lastKey = m[0].first;
-    debug_print("key '%s'\n", lastKey.data());
-    for (auto i = 1; i < l; i++) {
-        auto currentKey = m[i].first;
-        debug_print("key '%s'\n", currentKey.data());
-        if (currentKey == lastKey) {
-            throw EncodeError(fmt::format("found duplicated keys {}", lastKey));
+    for (auto keyValue : obj.attr("items")()) {
+        if (!PyTuple_Check(keyValue.ptr()) || PyTuple_GET_SIZE(keyValue.ptr()) != 2) {
+            throw py::type_error("items() must return (key, value) pairs");
         }
 
-        lastKey = currentKey;
+        addDictItem(items, PyTuple_GET_ITEM(keyValue.ptr(), 0),
+                    PyTuple_GET_ITEM(keyValue.ptr(), 1));
     }
-
-    for (auto pair : m) {
-        ctx->writeSize_t(pair.first.length());
-        ctx->writeChar(':');
-        ctx->write(pair.first.data(), pair.first.length());
-
-        encodeAny(ctx, pair.second);
-    }
-
-    ctx->writeChar('e');
-    return;
 }
 
 static void encodeInt_fast(Context *ctx, long long val) {
@@ -148,29 +126,19 @@ static void encodeInt(Context *ctx, py::handle obj) {
 }
 
 static void encodeInt_slow(Context *ctx, py::handle obj) {
-    HPy fmt = PyUnicode_FromString("%d");
-    if (fmt == NULL) {
-        return;
-    }
+    statAdd(StatEncodeBigInts, 1);
 
-    auto _0 = AutoFree(fmt);
-
-    HPy s = PyUnicode_Format(fmt, obj.ptr()); // s = '%d" % i
+    HPy s = PyNumber_ToBase(obj.ptr(), 10); // decimal str, always ascii
     if (s == NULL) {
-        return;
+        throw py::error_already_set();
     }
-    auto _1 = AutoFree(s);
-
-    HPy b = PyUnicode_AsUTF8String(s);
-    if (b == NULL) {
-        return;
-    }
-    auto _2 = AutoFree(b);
+    auto _0 = AutoFree(s);
 
+    // utf-8 of ascii str is its own data, no copy
     HPy_ssize_t size;
-    char *data;
-    if (PyBytes_AsStringAndSize(b, &data, &size)) {
-        return;
+    const char *data = PyUnicode_AsUTF8AndSize(s, &size);
+    if (data == NULL) {
+        throw py::error_already_set();
     }
 
     ctx->writeChar('i');
@@ -178,49 +146,21 @@ static void encodeInt_slow(Context *ctx, py::handle obj) {
     ctx->writeChar('e');
 }
 
-//
-static void encodeList(Context *ctx, const py::handle obj) {
-    ctx->writeChar('l');
-
-    HPy_ssize_t len = PyList_Size(obj.ptr());
-    for (HPy_ssize_t i = 0; i < len; i++) {
-        HPy o = PyList_GetItem(obj.ptr(), i);
-        encodeAny(ctx, o);
-    }
-
-    ctx->writeChar('e');
-}
-
-static void encodeTuple(Context *ctx, py::handle obj) {
-    ctx->writeChar('l');
+enum EncodeFrameKind { FrameList, FrameTuple, FrameDict };
 
-    HPy_ssize_t len = PyTuple_Size(obj.ptr());
-    for (HPy_ssize_t i = 0; i < len; i++) {
-        HPy o = PyTuple_GetItem(obj.ptr(), i);
-        encodeAny(ctx, o);
-    }
-
-    ctx->writeChar('e');
-}
-
-#define encodeComposeObject(ctx, obj, encoder)                                                     \
-    do {                                                                                           \
-        uintptr_t key = (uintptr_t)obj.ptr();                                                      \
-        debug_print("put object %p to seen", key);                                                 \
-        debug_print("after put object %p to seen", key);                                           \
-        if (ctx->seen.find(key) != ctx->seen.end()) {                                              \
-            debug_print("circular reference found");                                               \
-            throw py::value_error("circular reference found");                                     \
-        }                                                                                          \
-        ctx->seen.insert(key);                                                                     \
-        encoder(ctx, obj);                                                                         \
-        ctx->seen.erase(key);                                                                      \
-        return;                                                                                    \
-    } while (0)
-
-static void encodeAny(Context *ctx, const py::handle obj) {
-    debug_print("encodeAny");
+// a list, tuple or dict with its items being encoded
+struct EncodeFrame {
+    EncodeFrameKind kind;
+    py::object obj;
+    // next item to encode
+    HPy_ssize_t index;
+    // sorted items of dict
+    std::vector<DictItem> items;
+};
 
+// write `obj` if it's a scalar, or write its start and push it to `stack` if it's a container.
+static void encodeOne(Context *ctx, std::vector<EncodeFrame> &stack, py::handle obj,
+                      size_t maxDepth) {
     if (obj.ptr() == Py_True) {
         debug_print("encode true");
         ctx->write("i1e", 3);
@@ -270,18 +210,6 @@ static void encodeAny(Context *ctx, const py::handle obj) {
         return encodeInt(ctx, obj);
     }
 
-    if (PyList_Check(obj.ptr())) {
-        encodeComposeObject(ctx, obj, encodeList);
-    }
-
-    if (PyTuple_Check(obj.ptr())) {
-        encodeComposeObject(ctx, obj, encodeTuple);
-    }
-
-    if (PyDict_Check(obj.ptr())) {
-        encodeComposeObject(ctx, obj, encodeDict);
-    }
-
     if (PyByteArray_Check(obj.ptr())) {
         const char *s = PyByteArray_AsString(obj.ptr());
         size_t size = PyByteArray_Size(obj.ptr());
@@ -293,50 +221,231 @@ static void encodeAny(Context *ctx, const py::handle obj) {
         return;
     }
 
-    // types.MappingProxyType
-    debug_print("test if mapping proxy");
-    if (obj.ptr()->ob_type == &PyDictProxy_Type) {
-        debug_print("encode mapping proxy");
-        encodeComposeObject(ctx, obj, encodeDictLike);
+    EncodeFrameKind kind;
+    if (PyList_Check(obj.ptr())) {
+        kind = FrameList;
+    } else if (PyTuple_Check(obj.ptr())) {
+        kind = FrameTuple;
+    } else if (PyDict_Check(obj.ptr()) || obj.ptr()->ob_type == &PyDictProxy_Type) {
+        // types.MappingProxyType is encoded as dict
+        kind = FrameDict;
+    } else if (py::isinstance<BencodeRaw>(obj)) {
+        // already encoded, copy it as is
+        const BencodeRaw &raw = obj.cast<const BencodeRaw &>();
+        ctx->write(PyBytes_AS_STRING(raw.data.ptr()), PyBytes_GET_SIZE(raw.data.ptr()));
+        return;
+    } else {
+        // Unsupported type, raise TypeError
+        std::string repr = py::repr(obj.get_type());
+
+        std::string msg = "unsupported object " + repr;
+
+        throw py::type_error(msg);
     }
 
-    // Unsupported type, raise TypeError
-    std::string repr = py::repr(obj.get_type());
+    uintptr_t key = (uintptr_t)obj.ptr();
+    if (ctx->seen.find(key) != ctx->seen.end()) {
+        debug_print("circular reference found");
+        throw py::value_error("circular reference found");
+    }
 
-    std::string msg = "unsupported object " + repr;
+    if (stack.size() >= maxDepth) {
+        throw EncodeError(fmt::format("object nested too deep, max depth {}", maxDepth));
+    }
 
-    throw py::type_error(msg);
+    EncodeFrame f{kind, py::reinterpret_borrow<py::object>(obj), 0, {}};
+    if (kind == FrameDict) {
+        if (PyDict_Check(obj.ptr())) {
+            collectDict(obj, f.items);
+        } else {
+            collectDictLike(obj, f.items);
+        }
+
+        sortDictItems(f.items);
+    }
+
+    debug_print("put object %p to seen", key);
+    ctx->seen.insert(key);
+    ctx->writeChar(kind == FrameDict ? 'd' : 'l');
+    stack.push_back(std::move(f));
 }
 
-static std::vector<Context *> pool;
+// encode without recursion, nested containers are kept in an explicit stack so deep or hostile
+// objects can't overflow C stack.
+static void encodeTree(Context *ctx, py::handle obj, size_t maxDepth) {
+    debug_print("encodeTree");
+
+    std::vector<EncodeFrame> stack;
+    encodeOne(ctx, stack, obj, maxDepth);
+
+    while (!stack.empty()) {
+        EncodeFrame &top = stack.back();
+
+        // hold a reference, list may be changed by a `write()` of `bencode_to`
+        py::object next;
+        switch (top.kind) {
+        case FrameList:
+            if (top.index < PyList_GET_SIZE(top.obj.ptr())) {
+                next = py::reinterpret_borrow<py::object>(
+                    PyList_GET_ITEM(top.obj.ptr(), top.index++));
+            }
+            break;
+        case FrameTuple:
+            if (top.index < PyTuple_GET_SIZE(top.obj.ptr())) {
+                next = py::reinterpret_borrow<py::object>(
+                    PyTuple_GET_ITEM(top.obj.ptr(), top.index++));
+            }
+            break;
+        case FrameDict:
+            if (top.index < (HPy_ssize_t)top.items.size()) {
+                const DictItem &item = top.items[top.index++];
+                debug_print("key '%.*s'\n", (int)item.key.size(), item.key.data());
+                ctx->writeSize_t(item.key.size());
+                ctx->writeChar(':');
+                ctx->write(item.key.data(), item.key.size());
+                next = item.value;
+            }
+            break;
+        }
+
+        if (!next) {
+            ctx->writeChar('e');
+            ctx->seen.erase((uintptr_t)top.obj.ptr());
+            stack.pop_back();
+            continue;
+        }
+
+        // may push to stack, `top` is invalid after this
+        encodeOne(ctx, stack, next, maxDepth);
+    }
+}
+
+static void encodeAny(Context *ctx, py::handle obj, size_t maxDepth) {
+    statAdd(StatEncodeCalls, 1);
+    [[maybe_unused]] size_t start = ctx->flushed + ctx->index;
+
+    encodeTree(ctx, obj, maxDepth);
+
+    statAdd(StatBytesOut, ctx->flushed + ctx->index - start);
+}
+
+// exact length of encoded `obj`, counted by a context without buffer which drops all writes.
+static size_t encodedSize(py::handle obj, size_t maxDepth) {
+    Context ctx(NULL, 0);
+    encodeTree(&ctx, obj, maxDepth);
+
+    return ctx.index;
+}
+
+// encode into a bytes object of exact size, data is written once without growing or copying.
+static py::bytes encodeExact(py::handle obj, size_t maxDepth) {
+    size_t size = encodedSize(obj, maxDepth);
+
+    HPy b = PyBytes_FromStringAndSize(NULL, size);
+    if (b == NULL) {
+        throw py::error_already_set();
+    }
+    auto res = py::reinterpret_steal<py::bytes>(b);
+
+    Context ctx(PyBytes_AS_STRING(b), size);
+    encodeAny(&ctx, obj, maxDepth);
+
+    // `items()` of a mapping proxy may return different items in second pass
+    if (ctx.index != size) {
+        throw EncodeError("object changed during encoding");
+    }
+
+    return res;
+}
+
+// limits of context pool, set by `configure_pool()` and read by all threads without lock.
+static std::atomic<size_t> poolMaxContexts{defaultPoolContexts};
+static std::atomic<size_t> poolInitialSize{defaultBufferSize};
+static std::atomic<size_t> poolMaxRetained{defaultPoolMaxRetained};
+
+// each thread has its own pool, so concurrent encoding on free-threaded python
+// doesn't need any lock. contexts are freed when thread exits.
+static thread_local std::vector<std::unique_ptr<Context>> pool;
+
+// moving average of output size of recent calls in this thread
+static thread_local size_t recentSize = 0;
+
+// buffer size fitting recent outputs, it's never smaller than initial size or grown over max
+// retained size.
+static size_t adaptiveSize() {
+    size_t size = poolInitialSize.load(std::memory_order_relaxed);
+    size_t maxRetained = poolMaxRetained.load(std::memory_order_relaxed);
+
+    // leave room for output a little larger than average
+    size_t want = recentSize + recentSize / 2 + 1;
+    while (size < want && size <= maxRetained / 2) {
+        size *= 2;
+    }
+
+    return size;
+}
 
 std::unique_ptr<Context> getContext() {
     if (pool.empty()) {
         debug_print("empty pool, create Context");
-        return std::make_unique<Context>();
+        statAdd(StatPoolMisses, 1);
+        return std::make_unique<Context>(adaptiveSize());
     }
 
     debug_print("get Context from pool");
-    auto ctx = pool.back();
+    statAdd(StatPoolHits, 1);
+    auto ctx = std::move(pool.back());
     pool.pop_back();
 
-    return std::unique_ptr<Context>(ctx);
+    return ctx;
 }
 
-// 30 MiB
-size_t const ctx_buffer_reuse_cap = 30 * 1024 * 1024u;
-
 void releaseContext(std::unique_ptr<Context> ctx) {
-    if (pool.size() < 5 && ctx->cap <= ctx_buffer_reuse_cap) {
-        debug_print("put Context back to pool");
-        ctx.get()->reset();
-        pool.push_back(ctx.get());
-        ctx.release();
+    recentSize = recentSize - recentSize / 8 + ctx->index / 8;
+
+    if (pool.size() >= poolMaxContexts.load(std::memory_order_relaxed) ||
+        ctx->cap > poolMaxRetained.load(std::memory_order_relaxed)) {
+        debug_print("delete Context");
         return;
     }
 
-    debug_print("delete Context");
-    ctx.reset();
+    debug_print("put Context back to pool");
+    ctx->reset();
+
+    // don't pin memory grown by a rare large output
+    size_t target = adaptiveSize();
+    if (ctx->cap > target * 4) {
+        ctx->shrink(target);
+    }
+
+    pool.push_back(std::move(ctx));
+}
+
+void configure_pool(size_t maxContexts, size_t initialSize, size_t maxRetained) {
+    // make sure a length prefix or a single char always fit
+    if (initialSize < 64) {
+        throw py::value_error("initial_size must be at least 64");
+    }
+
+    // a fresh context would be dropped right after use, pool could never retain anything
+    if (initialSize > maxRetained) {
+        throw py::value_error(fmt::format("initial_size {} is larger than max_retained {}",
+                                          initialSize, maxRetained));
+    }
+
+    poolMaxContexts.store(maxContexts, std::memory_order_relaxed);
+    poolInitialSize.store(initialSize, std::memory_order_relaxed);
+    poolMaxRetained.store(maxRetained, std::memory_order_relaxed);
+
+    // pools of other threads follow new limits when contexts are released
+    pool.erase(std::remove_if(pool.begin(), pool.end(),
+                              [maxRetained](const std::unique_ptr<Context> &ctx) {
+                                  return ctx->cap > maxRetained;
+                              }),
+               pool.end());
+    if (pool.size() > maxContexts) {
+        pool.resize(maxContexts);
+    }
 }
 
 class CtxMgr {
@@ -347,13 +456,121 @@ public:
     ~CtxMgr() { releaseContext(std::move(ptr)); }
 };
 
-py::bytes bencode(py::object v) {
-    debug_print("1");
+// encode one value with a context managed by caller
+void encodeValue(Context *ctx, py::handle obj) { encodeAny(ctx, obj, defaultMaxDepth); }
+
+py::bytes bencode(py::object v, size_t maxDepth, bool exactSize) {
+    if (exactSize) {
+        return encodeExact(v, maxDepth);
+    }
+
     auto ctx = CtxMgr();
 
-    encodeAny(ctx.ptr.get(), v);
+    encodeAny(ctx.ptr.get(), v, maxDepth);
 
     auto res = py::bytes(ctx.ptr->buf, ctx.ptr->index);
 
     return res;
 }
+
+// write all data to file descriptor, with GIL released.
+static void writeFd(int fd, const char *data, size_t size) {
+    while (size != 0) {
+        long n;
+        {
+            py::gil_scoped_release release;
+#ifdef _WIN32
+            n = _write(fd, data, (unsigned int)std::min(size, (size_t)INT_MAX));
+#else
+            n = ::write(fd, data, size);
+#endif
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                if (PyErr_CheckSignals()) {
+                    throw py::error_already_set();
+                }
+                continue;
+            }
+
+            PyErr_SetFromErrno(PyExc_OSError);
+            throw py::error_already_set();
+        }
+
+        data += n;
+        size -= n;
+    }
+}
+
+// call `fp.write()` until all data is written, raw io may write partially.
+static void writeFile(py::handle write, const char *data, size_t size) {
+    while (size != 0) {
+        py::object n = write(py::bytes(data, size));
+        if (n.is_none()) {
+            return;
+        }
+
+        size_t written = n.cast<size_t>();
+        // nothing written would loop forever
+        if (written == 0 || written > size) {
+            PyErr_Format(PyExc_OSError, "write() returned %zu, %zu bytes to write", written, size);
+            throw py::error_already_set();
+        }
+
+        data += written;
+        size -= written;
+    }
+}
+
+size_t bencode_to(py::object v, py::object file, size_t bufferSize, size_t maxDepth) {
+    // make sure a length prefix or a single char always fit
+    if (bufferSize < 64) {
+        bufferSize = 64;
+    }
+
+    auto ctx = std::make_unique<Context>(bufferSize);
+
+    if (PyLong_Check(file.ptr())) {
+        int fd = file.cast<int>();
+        ctx->sink = [fd](const char *data, size_t size) { writeFd(fd, data, size); };
+    } else {
+        py::object write = file.attr("write");
+        ctx->sink = [write](const char *data, size_t size) { writeFile(write, data, size); };
+    }
+
+    encodeAny(ctx.get(), v, maxDepth);
+
+    ctx->flush();
+
+    return ctx->flushed;
+}
+
+size_t bencode_into(py::object v, py::object buffer, Py_ssize_t offset, size_t maxDepth) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(buffer.ptr(), &view, PyBUF_WRITABLE)) {
+        PyErr_Clear();
+        throw py::type_error("can only encode into writable bytes-like object");
+    }
+    auto _ = AutoReleaseBuffer(&view);
+
+    if (offset < 0 || offset > view.len) {
+        throw py::value_error(
+            fmt::format("offset {} out of range of buffer length {}", offset, view.len));
+    }
+
+    size_t available = view.len - offset;
+    Context ctx((char *)view.buf + offset, available);
+
+    encodeAny(&ctx, v, maxDepth);
+
+    if (ctx.index > available) {
+        throw py::value_error(fmt::format(
+            "buffer too small, encoded data need {} bytes but only {} bytes available", ctx.index,
+            available));
+    }
+
+    return ctx.index;
+}
+
+size_t bencoded_size(py::object v, size_t maxDepth) { return encodedSize(v, maxDepth); }
@@ -0,0 +1,65 @@
+#define FMT_HEADER_ONLY
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include <fmt/core.h>
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "intern.h"
+
+namespace py = pybind11;
+
+static std::mutex internLock;
+
+// never freed, python objects in it can't be released after interpreter finalization.
+static auto *internTable = new std::shared_ptr<const InternTable>();
+
+// if `internTable` is not empty, checked before locking so default decoding never takes the lock.
+static std::atomic<bool> internTableUsed{false};
+
+std::shared_ptr<const InternTable> currentInternTable() {
+    if (!internTableUsed.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(internLock);
+    return *internTable;
+}
+
+// replace process wide shared dict keys, pass empty iterable to clear it.
+void intern_keys(py::iterable keys) {
+    auto table = std::make_shared<InternTable>();
+
+    for (auto key : keys) {
+        if (!PyBytes_CheckExact(key.ptr())) {
+            throw py::type_error("interned keys must be bytes");
+        }
+
+        if (PyBytes_GET_SIZE(key.ptr()) > maxInternKeyLength) {
+            throw py::value_error(
+                fmt::format("interned keys can't be longer than {} bytes", maxInternKeyLength));
+        }
+
+        std::string_view view(PyBytes_AS_STRING(key.ptr()), PyBytes_GET_SIZE(key.ptr()));
+        if (table->keys.find(view) != table->keys.end()) {
+            continue;
+        }
+
+        Py_INCREF(key.ptr());
+        table->keys.emplace(view, key.ptr());
+    }
+
+    std::shared_ptr<const InternTable> old;
+    {
+        std::lock_guard<std::mutex> lock(internLock);
+        old = std::move(*internTable);
+        bool used = !table->keys.empty();
+        *internTable = used ? std::move(table) : nullptr;
+        internTableUsed.store(used, std::memory_order_release);
+    }
+
+    // `old` is released here, outside of lock
+}
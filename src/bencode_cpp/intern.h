@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.h"
+
+// dict keys longer than this are never interned
+#define maxInternKeyLength 64
+
+// slots of per call key cache, must be power of 2
+#define keyCacheSlots 256
+
+// process wide shared keys set by `intern_keys`, never changed after it's built.
+class InternTable {
+public:
+    // views into the bytes objects held by the table
+    std::unordered_map<std::string_view, HPy> keys;
+
+    ~InternTable() {
+        for (auto &item : keys) {
+            Py_DECREF(item.second);
+        }
+    }
+};
+
+// nullptr if `intern_keys` is never called or the table is cleared.
+extern std::shared_ptr<const InternTable> currentInternTable();
+
+// share dict key objects during one decoding call.
+// a key is looked up in a small direct mapped cache, then in the process wide table.
+class KeyCache {
+public:
+    KeyCache() : table(currentInternTable()) {}
+
+    ~KeyCache() {
+        if (!slotsReady) {
+            return;
+        }
+
+        for (HPy o : slots) {
+            Py_XDECREF(o);
+        }
+    }
+
+    KeyCache(const KeyCache &) = delete;
+    KeyCache &operator=(const KeyCache &) = delete;
+
+    // new reference of bytes object, NULL with python error set on failure.
+    HPy get(const char *s, size_t len) {
+        if (len > maxInternKeyLength) {
+            return PyBytes_FromStringAndSize(s, len);
+        }
+
+        // FNV-1a
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ (unsigned char)s[i]) * 16777619u;
+        }
+
+        // cleared on first key, decoding data without dict never pays for it
+        if (!slotsReady) {
+            memset(slots, 0, sizeof(slots));
+            slotsReady = true;
+        }
+
+        HPy &slot = slots[h & (keyCacheSlots - 1)];
+        if (slot != NULL && (size_t)PyBytes_GET_SIZE(slot) == len &&
+            memcmp(PyBytes_AS_STRING(slot), s, len) == 0) {
+            Py_INCREF(slot);
+            return slot;
+        }
+
+        HPy o = NULL;
+        if (table) {
+            auto it = table->keys.find(std::string_view(s, len));
+            if (it != table->keys.end()) {
+                o = it->second;
+                Py_INCREF(o);
+            }
+        }
+
+        if (o == NULL) {
+            o = PyBytes_FromStringAndSize(s, len);
+            if (o == NULL) {
+                return NULL;
+            }
+        }
+
+        Py_XDECREF(slot);
+        Py_INCREF(o);
+        slot = o;
+
+        return o;
+    }
+
+private:
+    std::shared_ptr<const InternTable> table;
+    bool slotsReady = false;
+    HPy slots[keyCacheSlots];
+};
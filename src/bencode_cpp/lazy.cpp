@@ -0,0 +1,309 @@
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "intern.h"
+#include "tape.h"
+
+namespace py = pybind11;
+
+// decoded buffer and its index, shared by all lazy proxies created from it.
+// the buffer is held until the last proxy is garbage collected.
+class LazyDoc {
+public:
+    Py_buffer view;
+    Tape tape;
+
+    LazyDoc(py::object b) {
+        if (PyObject_GetBuffer(b.ptr(), &view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            throw py::type_error("can only decode bytes-like object");
+        }
+    }
+
+    ~LazyDoc() { PyBuffer_Release(&view); }
+
+    const char *buf() const { return (const char *)view.buf; }
+};
+
+static py::object lazyValue(const std::shared_ptr<LazyDoc> &doc, uint32_t entry);
+
+static py::object intFromSpan(const char *s, size_t len) {
+    long long val;
+    if (parseInt(s, 0, len, val)) {
+        return py::reinterpret_steal<py::object>(PyLong_FromLongLong(val));
+    }
+
+    // out of long long range
+    HPy i = longFromDigits(s, len);
+    if (i == NULL) {
+        throw py::error_already_set();
+    }
+
+    return py::reinterpret_steal<py::object>(i);
+}
+
+static py::object scalarValue(const char *buf, const TapeEntry &e) {
+    if (e.kind == TapeInt) {
+        return intFromSpan(buf + e.start, e.end - e.start);
+    }
+
+    return py::bytes(buf + e.start, e.end - e.start);
+}
+
+struct LazyFrame {
+    py::object container;
+    uint32_t next;
+    // pending key of dict
+    py::object key;
+};
+
+static void appendTo(LazyFrame &f, py::object v) {
+    int r;
+    if (PyList_Check(f.container.ptr())) {
+        r = PyList_Append(f.container.ptr(), v.ptr());
+    } else if (!f.key) {
+        f.key = std::move(v);
+        return;
+    } else {
+        r = PyDict_SetItem(f.container.ptr(), f.key.ptr(), v.ptr());
+        f.key = py::object();
+    }
+
+    if (r) {
+        throw py::error_already_set();
+    }
+}
+
+// materialize a whole value into python objects, without recursion.
+py::object tapeToPython(const char *buf, const Tape &tape, uint32_t entry) {
+    const auto &entries = tape.entries;
+
+    if (entries[entry].kind == TapeInt || entries[entry].kind == TapeBytes) {
+        return scalarValue(buf, entries[entry]);
+    }
+
+    std::vector<LazyFrame> stack;
+    KeyCache keys;
+
+    uint32_t i = entry;
+    while (1) {
+        // close containers ending before current entry
+        while (!stack.empty() && stack.back().next == i) {
+            py::object done = std::move(stack.back().container);
+            stack.pop_back();
+            if (stack.empty()) {
+                return done;
+            }
+
+            appendTo(stack.back(), std::move(done));
+        }
+
+        const TapeEntry &e = entries[i];
+        i++;
+
+        if (e.kind == TapeList) {
+            stack.push_back(LazyFrame{py::list(0), e.next, py::object()});
+        } else if (e.kind == TapeDict) {
+            stack.push_back(LazyFrame{py::dict(), e.next, py::object()});
+        } else if (!stack.back().key && PyDict_Check(stack.back().container.ptr())) {
+            HPy key = keys.get(buf + e.start, e.end - e.start);
+            if (key == NULL) {
+                throw py::error_already_set();
+            }
+            stack.back().key = py::reinterpret_steal<py::object>(key);
+        } else {
+            appendTo(stack.back(), scalarValue(buf, e));
+        }
+    }
+}
+
+class LazyList {
+public:
+    std::shared_ptr<LazyDoc> doc;
+    uint32_t entry;
+    std::vector<uint32_t> items;
+
+    LazyList(std::shared_ptr<LazyDoc> d, uint32_t e) : doc(std::move(d)), entry(e) {
+        const auto &entries = doc->tape.entries;
+        for (uint32_t i = entry + 1; i < entries[entry].next; i = entries[i].next) {
+            items.push_back(i);
+        }
+    }
+
+    size_t len() const { return items.size(); }
+
+    py::object getItem(Py_ssize_t index) const {
+        Py_ssize_t size = (Py_ssize_t)items.size();
+        if (index < 0) {
+            index += size;
+        }
+
+        if (index < 0 || index >= size) {
+            throw py::index_error("list index out of range");
+        }
+
+        return lazyValue(doc, items[index]);
+    }
+
+    py::list values() const {
+        py::list l(0);
+        for (auto i : items) {
+            l.append(lazyValue(doc, i));
+        }
+
+        return l;
+    }
+
+    py::object toPython() const { return tapeToPython(doc->buf(), doc->tape, entry); }
+};
+
+class LazyDict {
+public:
+    std::shared_ptr<LazyDoc> doc;
+    uint32_t entry;
+    // entry index of keys, value is the entry after key.
+    std::vector<uint32_t> keyEntries;
+
+    LazyDict(std::shared_ptr<LazyDoc> d, uint32_t e) : doc(std::move(d)), entry(e) {
+        const auto &entries = doc->tape.entries;
+        for (uint32_t i = entry + 1; i < entries[entry].next; i = entries[entries[i].next].next) {
+            keyEntries.push_back(i);
+        }
+    }
+
+    size_t len() const { return keyEntries.size(); }
+
+    // keys are validated to be sorted, binary search them.
+    // return entry index of value, or 0 if not found.
+    uint32_t find(py::handle key) const {
+        Py_buffer view;
+        if (PyObject_GetBuffer(key.ptr(), &view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            return 0;
+        }
+        auto _ = AutoReleaseBuffer(&view);
+
+        const auto &entries = doc->tape.entries;
+        std::string_view k((const char *)view.buf, view.len);
+
+        size_t lo = 0;
+        size_t hi = keyEntries.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const TapeEntry &e = entries[keyEntries[mid]];
+            std::string_view current(doc->buf() + e.start, e.end - e.start);
+
+            int r = current.compare(k);
+            if (r == 0) {
+                return keyEntries[mid] + 1;
+            }
+
+            if (r < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        return 0;
+    }
+
+    py::object getItem(py::handle key) const {
+        uint32_t v = find(key);
+        if (v == 0) {
+            PyErr_SetObject(PyExc_KeyError, key.ptr());
+            throw py::error_already_set();
+        }
+
+        return lazyValue(doc, v);
+    }
+
+    py::object get(py::handle key, py::object defaultValue) const {
+        uint32_t v = find(key);
+        if (v == 0) {
+            return defaultValue;
+        }
+
+        return lazyValue(doc, v);
+    }
+
+    bool contains(py::handle key) const { return find(key) != 0; }
+
+    py::list keys() const {
+        py::list l(0);
+        for (auto k : keyEntries) {
+            l.append(scalarValue(doc->buf(), doc->tape.entries[k]));
+        }
+
+        return l;
+    }
+
+    py::list values() const {
+        py::list l(0);
+        for (auto k : keyEntries) {
+            l.append(lazyValue(doc, k + 1));
+        }
+
+        return l;
+    }
+
+    py::list items() const {
+        py::list l(0);
+        for (auto k : keyEntries) {
+            l.append(py::make_tuple(scalarValue(doc->buf(), doc->tape.entries[k]),
+                                    lazyValue(doc, k + 1)));
+        }
+
+        return l;
+    }
+
+    py::object toPython() const { return tapeToPython(doc->buf(), doc->tape, entry); }
+};
+
+static py::object lazyValue(const std::shared_ptr<LazyDoc> &doc, uint32_t entry) {
+    const TapeEntry &e = doc->tape.entries[entry];
+
+    if (e.kind == TapeList) {
+        return py::cast(LazyList(doc, entry));
+    }
+
+    if (e.kind == TapeDict) {
+        return py::cast(LazyDict(doc, entry));
+    }
+
+    return scalarValue(doc->buf(), e);
+}
+
+py::object bdecode_lazy(py::object b) {
+    auto doc = std::make_shared<LazyDoc>(b);
+    statAdd(StatDecodeCalls, 1);
+    statAdd(StatBytesIn, doc->view.len);
+
+    doc->tape.build(doc->buf(), doc->view.len);
+
+    return lazyValue(doc, 0);
+}
+
+void registerLazyTypes(py::module_ &m) {
+    py::class_<LazyList>(m, "LazyList")
+        .def("__len__", &LazyList::len)
+        .def("__getitem__", &LazyList::getItem)
+        .def("__iter__", [](const LazyList &self) { return py::iter(self.values()); })
+        .def("to_python", &LazyList::toPython);
+
+    py::class_<LazyDict>(m, "LazyDict")
+        .def("__len__", &LazyDict::len)
+        .def("__getitem__", &LazyDict::getItem)
+        .def("__contains__", &LazyDict::contains)
+        .def("__iter__", [](const LazyDict &self) { return py::iter(self.keys()); })
+        .def("get", &LazyDict::get, py::arg("key"), py::arg("default") = py::none())
+        .def("keys", &LazyDict::keys)
+        .def("values", &LazyDict::values)
+        .def("items", &LazyDict::items)
+        .def("to_python", &LazyDict::toPython);
+}
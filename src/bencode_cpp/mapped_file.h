@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read-only memory mapping of a whole file.
+// doesn't touch python API, so it can be used without holding the GIL.
+class MappedFile {
+public:
+    const char *data = nullptr;
+    size_t size = 0;
+    // errno (or GetLastError() on windows) of the failed call
+    unsigned long err = 0;
+
+    MappedFile() {}
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() { close(); }
+
+#ifdef _WIN32
+    bool open(const wchar_t *path) {
+        HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            err = GetLastError();
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            err = GetLastError();
+            CloseHandle(file);
+            return false;
+        }
+
+        size = (size_t)fileSize.QuadPart;
+        // can't map empty file
+        if (size == 0) {
+            CloseHandle(file);
+            return true;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (mapping == NULL) {
+            err = GetLastError();
+            return false;
+        }
+
+        data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (data == NULL) {
+            err = GetLastError();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close() {
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+            data = nullptr;
+        }
+    }
+#else
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            err = errno;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st)) {
+            err = errno;
+            ::close(fd);
+            return false;
+        }
+
+        size = (size_t)st.st_size;
+        // can't map empty file
+        if (size == 0) {
+            ::close(fd);
+            return true;
+        }
+
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        // fault pages in now, not while decoding
+        flags |= MAP_POPULATE;
+#endif
+
+        void *p = mmap(NULL, size, PROT_READ, flags, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            err = errno;
+            return false;
+        }
+
+#ifndef MAP_POPULATE
+        madvise(p, size, MADV_WILLNEED);
+#endif
+
+        data = (const char *)p;
+        return true;
+    }
+
+    void close() {
+        if (data != nullptr) {
+            munmap((void *)data, size);
+            data = nullptr;
+        }
+    }
+#endif
+};
@@ -0,0 +1,207 @@
+#include <string_view>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "scan.h"
+#include "sha.h"
+
+namespace py = pybind11;
+
+extern py::object decodeValue(const char *buf, Py_ssize_t *index, Py_ssize_t size,
+                              size_t maxDepth);
+
+// convert python sequence of bytes/str keys and int indexes to query path.
+// python objects are kept in `refs` so key views stay valid.
+static std::vector<PathItem> toPath(py::handle keyPath, std::vector<py::object> &refs) {
+    // iterating them gives chars or ints, which is never what caller wants
+    if (PyBytes_Check(keyPath.ptr()) || PyUnicode_Check(keyPath.ptr()) ||
+        PyByteArray_Check(keyPath.ptr())) {
+        throw py::type_error("key path must be a sequence of keys, not bytes, str or bytearray");
+    }
+
+    std::vector<PathItem> path;
+
+    for (auto item : keyPath) {
+        refs.push_back(py::reinterpret_borrow<py::object>(item));
+
+        if (PyBytes_Check(item.ptr())) {
+            const char *s = PyBytes_AS_STRING(item.ptr());
+            path.push_back(PathItem{false, 0, std::string_view(s, PyBytes_GET_SIZE(item.ptr()))});
+            continue;
+        }
+
+        if (PyUnicode_Check(item.ptr())) {
+            Py_ssize_t size = 0;
+            const char *s = PyUnicode_AsUTF8AndSize(item.ptr(), &size);
+            if (s == NULL) {
+                throw py::error_already_set();
+            }
+
+            path.push_back(PathItem{false, 0, std::string_view(s, size)});
+            continue;
+        }
+
+        // bool is a subclass of int, but `True` as list index is surely a mistake
+        if (PyBool_Check(item.ptr())) {
+            throw py::type_error("key path items must be bytes, str or int, not bool");
+        }
+
+        if (PyLong_Check(item.ptr())) {
+            Py_ssize_t index = PyLong_AsSsize_t(item.ptr());
+            if (index == -1 && PyErr_Occurred()) {
+                throw py::error_already_set();
+            }
+
+            if (index < 0) {
+                throw py::value_error("list index in key path must not be negative");
+            }
+
+            path.push_back(PathItem{true, (size_t)index, std::string_view()});
+            continue;
+        }
+
+        throw py::type_error("key path items must be bytes, str or int");
+    }
+
+    return path;
+}
+
+// find raw value of `path` in buffer, with GIL released.
+// raise KeyError if not found.
+static void findRaw(const Py_buffer &view, py::handle keyPath, const std::vector<PathItem> &path,
+                    size_t &start, size_t &end) {
+    bool found;
+
+    {
+        py::gil_scoped_release release;
+        found = findPath((const char *)view.buf, view.len, path, start, end);
+    }
+
+    if (!found) {
+        PyErr_SetObject(PyExc_KeyError, keyPath.ptr());
+        throw py::error_already_set();
+    }
+}
+
+static void getBuffer(py::handle b, Py_buffer *view) {
+    if (PyObject_GetBuffer(b.ptr(), view, PyBUF_SIMPLE)) {
+        PyErr_Clear();
+        throw py::type_error("can only decode bytes-like object");
+    }
+}
+
+py::bytes raw_value(py::object b, py::object keyPath) {
+    std::vector<py::object> refs;
+    auto path = toPath(keyPath, refs);
+
+    Py_buffer view;
+    getBuffer(b, &view);
+    auto _ = AutoReleaseBuffer(&view);
+
+    size_t start, end;
+    findRaw(view, keyPath, path, start, end);
+
+    return py::bytes((const char *)view.buf + start, end - start);
+}
+
+// decode only the value at `key_path`, other values are validated and skipped.
+// `maxDepth` limits nesting inside the found value.
+py::object bdecode_path(py::object b, py::object keyPath, size_t maxDepth) {
+    std::vector<py::object> refs;
+    auto path = toPath(keyPath, refs);
+
+    Py_buffer view;
+    getBuffer(b, &view);
+    auto _ = AutoReleaseBuffer(&view);
+
+    size_t start, end;
+    findRaw(view, keyPath, path, start, end);
+
+    Py_ssize_t index = start;
+    return decodeValue((const char *)view.buf, &index, end, maxDepth);
+}
+
+// decode values of all `key_paths` in one pass, `default` for paths not found.
+py::list bdecode_paths(py::object b, py::iterable keyPaths, py::object defaultValue,
+                       size_t maxDepth) {
+    std::vector<py::object> refs;
+    std::vector<std::vector<PathItem>> paths;
+    for (auto keyPath : keyPaths) {
+        paths.push_back(toPath(keyPath, refs));
+    }
+
+    Py_buffer view;
+    getBuffer(b, &view);
+    auto _ = AutoReleaseBuffer(&view);
+
+    std::vector<PathSpan> spans;
+    {
+        py::gil_scoped_release release;
+        spans = findPaths((const char *)view.buf, view.len, paths);
+    }
+
+    py::list results(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (spans[i].end == 0) {
+            results[i] = defaultValue;
+            continue;
+        }
+
+        Py_ssize_t index = spans[i].start;
+        results[i] = decodeValue((const char *)view.buf, &index, spans[i].end, maxDepth);
+    }
+
+    return results;
+}
+
+py::bytes info_hash(py::object b, bool v2) {
+    Py_buffer view;
+    getBuffer(b, &view);
+    auto _ = AutoReleaseBuffer(&view);
+
+    std::vector<PathItem> path{PathItem{false, 0, "info"}};
+
+    size_t start, end;
+    findRaw(view, py::str("info"), path, start, end);
+
+    const char *buf = (const char *)view.buf;
+    if (buf[start] != 'd') {
+        throw DecodeError("invalid torrent, info is not a dict");
+    }
+
+    unsigned char digest[32];
+    size_t digestSize = v2 ? 32 : 20;
+
+    {
+        py::gil_scoped_release release;
+        if (v2) {
+            sha256(buf + start, end - start, digest);
+        } else {
+            sha1(buf + start, end - start, digest);
+        }
+    }
+
+    return py::bytes((const char *)digest, digestSize);
+}
+
+// None if `b` is valid, or offset of the invalid data. no object is created while validating.
+py::object bvalidate(py::object b) {
+    Py_buffer view;
+    getBuffer(b, &view);
+    auto _ = AutoReleaseBuffer(&view);
+
+    size_t offset = 0;
+    bool ok;
+    {
+        py::gil_scoped_release release;
+        ok = validate((const char *)view.buf, view.len, offset);
+    }
+
+    if (ok) {
+        return py::none();
+    }
+
+    return py::int_(offset);
+}
@@ -0,0 +1,48 @@
+#define FMT_HEADER_ONLY
+
+#include <string>
+
+#include <fmt/core.h>
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "raw.h"
+#include "scan.h"
+
+namespace py = pybind11;
+
+// copy bencoded data from python, it must be exactly one valid value.
+static BencodeRaw newRaw(py::object b) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(b.ptr(), &view, PyBUF_SIMPLE)) {
+        PyErr_Clear();
+        throw py::type_error("BencodeRaw can only be created from bytes-like object");
+    }
+    auto _ = AutoReleaseBuffer(&view);
+
+    size_t offset = 0;
+    if (!validate((const char *)view.buf, view.len, offset)) {
+        throw DecodeError(fmt::format("invalid bencode data, index {}", offset));
+    }
+
+    return BencodeRaw(py::bytes((const char *)view.buf, view.len));
+}
+
+void registerRawType(py::module_ &m) {
+    py::class_<BencodeRaw>(m, "BencodeRaw")
+        .def(py::init(&newRaw), py::arg("b"))
+        .def("__bytes__", [](const BencodeRaw &self) { return self.data; })
+        .def("__len__", [](const BencodeRaw &self) { return PyBytes_GET_SIZE(self.data.ptr()); })
+        .def("__eq__",
+             [](const BencodeRaw &self, py::object other) -> py::object {
+                 if (!py::isinstance<BencodeRaw>(other)) {
+                     return py::reinterpret_borrow<py::object>(Py_NotImplemented);
+                 }
+
+                 return py::bool_(self.data.equal(other.cast<const BencodeRaw &>().data));
+             })
+        .def("__hash__", [](const BencodeRaw &self) { return py::hash(self.data); })
+        .def("__repr__", [](const BencodeRaw &self) {
+            return "BencodeRaw(" + std::string(py::repr(self.data)) + ")";
+        });
+}
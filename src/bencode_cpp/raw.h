@@ -0,0 +1,15 @@
+#pragma once
+
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+
+namespace py = pybind11;
+
+// a bencoded value kept as encoded bytes, encoder copies it to output as is.
+class BencodeRaw {
+public:
+    py::bytes data;
+
+    explicit BencodeRaw(py::bytes b) : data(std::move(b)) {}
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "base.h"
+#include "scan.h"
+
+// event based parser, calls visitor methods as values are parsed without building any tree.
+//
+// visitor is any type with these methods, they are resolved at compile time:
+//
+//   void onInt(long long val);
+//   void onBigInt(std::string_view digits); // int out of long long range, like "-184467..."
+//   void onBytes(std::string_view s);
+//   void onKey(std::string_view key);       // dict key, followed by events of its value
+//   void onListBegin();
+//   void onDictBegin();
+//   void onEnd();                            // end of current list or dict
+//
+// spans point into the parsed buffer. data is validated as it goes, so visitor may receive
+// some events before DecodeError is thrown.
+
+// `scanValue` handler translating token spans into visitor events.
+template <typename V> struct SaxHandler {
+    const char *buf;
+    V &visitor;
+
+    void onInt(size_t start, size_t end, long long val, bool fits) {
+        if (fits) {
+            visitor.onInt(val);
+        } else {
+            visitor.onBigInt(std::string_view(buf + start, end - start));
+        }
+    }
+
+    void onBytes(size_t start, size_t end, bool isKey) {
+        std::string_view s(buf + start, end - start);
+        if (isKey) {
+            visitor.onKey(s);
+        } else {
+            visitor.onBytes(s);
+        }
+    }
+
+    void onBegin(size_t, bool isDict) {
+        if (isDict) {
+            visitor.onDictBegin();
+        } else {
+            visitor.onListBegin();
+        }
+    }
+
+    void onEnd(size_t) { visitor.onEnd(); }
+};
+
+// parse one value at `index` and move `index` after it.
+template <typename V> static inline void saxParseValue(const char *buf, size_t size, size_t &index,
+                                                       V &visitor) {
+    SaxHandler<V> h{buf, visitor};
+    scanValue(buf, size, index, h, true);
+}
+
+// parse the whole buffer, it must contain exactly one value.
+template <typename V> static inline void saxParse(std::string_view buf, V &visitor) {
+    if (buf.empty()) {
+        throw DecodeError("can't decode empty bytes");
+    }
+
+    size_t index = 0;
+    saxParseValue(buf.data(), buf.size(), index, visitor);
+
+    if (index != buf.size()) {
+        scanErrF("invalid bencode data, parse end at index {} but total bytes length {}", index,
+                 buf.size());
+    }
+}
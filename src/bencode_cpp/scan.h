@@ -0,0 +1,507 @@
+#pragma once
+#define FMT_HEADER_ONLY
+
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "base.h"
+
+// validating scanners over raw bencode buffer, they don't touch python objects
+// so they can run without holding the GIL.
+
+#define scanErrF(f, ...) throw DecodeError(fmt::format(f, ##__VA_ARGS__));
+
+// compare two keys as bytes
+static inline int compareKey(const char *a, size_t aLen, const char *b, size_t bLen) {
+    int r = memcmp(a, b, aLen < bLen ? aLen : bLen);
+    if (r != 0) {
+        return r;
+    }
+    if (aLen == bLen) {
+        return 0;
+    }
+    return aLen < bLen ? -1 : 1;
+}
+
+// load 8 bytes, first byte in the lowest bits.
+static inline uint64_t load8(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// all 8 bytes are '0'-'9'
+static inline bool isDigits8(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) |
+            (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+// value of 8 digits, pairs then quads are combined with multiplication.
+static inline uint32_t parseDigits8(uint64_t v) {
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)v;
+}
+
+// parse digits in [p, p+n) 8 bytes at a time, return false if there is non-digit char.
+// `val` wraps around if n > 19.
+static inline bool parseDigits(const char *p, size_t n, uint64_t &val) {
+    uint64_t v = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t block = load8(p + i);
+        if (!isDigits8(block)) {
+            return false;
+        }
+        v = v * 100000000 + parseDigits8(block);
+    }
+
+    for (; i < n; i++) {
+        unsigned d = (unsigned char)p[i] - '0';
+        if (d > 9) {
+            return false;
+        }
+        v = v * 10 + d;
+    }
+
+    val = v;
+    return true;
+}
+
+// offset of first non-digit char in [p, p+n), only called on error path for message.
+static inline size_t findNonDigit(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && p[i] >= '0' && p[i] <= '9') {
+        i++;
+    }
+    return i;
+}
+
+// validate int at `index` ('i'), return offset of the ending 'e'.
+// `val` is set and `fits` is true if it's in long long range.
+static inline size_t scanInt(const char *buf, size_t size, size_t index, long long &val,
+                             bool &fits) {
+    const char *p = (const char *)memchr(buf + index + 1, 'e', size - index - 1);
+    if (p == NULL) {
+        scanErrF("invalid int, missing 'e': {}", index);
+    }
+
+    size_t end = p - buf;
+    size_t i = index + 1;
+    bool negative = false;
+
+    if (buf[i] == '-') {
+        i++;
+        negative = true;
+        if (buf[i] == '0') {
+            scanErrF("invalid int, '-0' found at {}", i);
+        }
+    } else if (buf[i] == '0' && i + 1 != end) {
+        scanErrF("invalid int, non-zero int should not start with '0'. found at {}", i);
+    }
+
+    if (i == end) {
+        scanErrF("invalid int, no digits found at {}", i);
+    }
+
+    uint64_t u;
+    if (!parseDigits(buf + i, end - i, u)) {
+        i += findNonDigit(buf + i, end - i);
+        scanErrF("invalid int, '{:c}' found at {}", buf[i], i);
+    }
+
+    // 19 digits may overflow long long, 20 digits may overflow uint64_t
+    const uint64_t limit = (uint64_t)LLONG_MAX + (negative ? 1 : 0);
+    fits = end - i < 20 && u <= limit;
+    if (fits) {
+        val = negative ? (long long)(0 - u) : (long long)u;
+    }
+
+    return end;
+}
+
+// validate int at `index` ('i'), return offset of the ending 'e'.
+static inline size_t scanInt(const char *buf, size_t size, size_t index) {
+    long long val;
+    bool fits;
+    return scanInt(buf, size, index, val, fits);
+}
+
+// parse a validated int in [start, end) like "-123", return false if it overflow long long.
+static inline bool parseInt(const char *buf, size_t start, size_t end, long long &val) {
+    return std::from_chars(buf + start, buf + end, val).ec == std::errc();
+}
+
+// validate bytes at `index`, return offset of content and move `index` after it.
+static inline size_t scanBytes(const char *buf, size_t size, size_t &index) {
+    const char *p = (const char *)memchr(buf + index, ':', size - index);
+    if (p == NULL) {
+        scanErrF("invalid string, missing length: index {}", index);
+    }
+
+    size_t sep = p - buf;
+
+    if (buf[index] == '0' && index + 1 != sep) {
+        scanErrF("invalid bytes length, found at {}", index);
+    }
+
+    uint64_t len;
+    if (!parseDigits(buf + index, sep - index, len)) {
+        size_t i = index + findNonDigit(buf + index, sep - index);
+        scanErrF("invalid bytes length, found '{:c}' at {}", buf[i], i);
+    }
+
+    // more than 19 digits is larger than the buffer anyway, `len` may have wrapped around
+    if (sep - index > 19 || len > size - sep - 1) {
+        scanErrF("bytes length overflow, index {}", index);
+    }
+
+    index = sep + 1 + len;
+
+    return sep + 1;
+}
+
+// stack kept inline for usual nesting depth, only deeper nesting allocates.
+template <typename T, size_t N> class SmallStack {
+public:
+    bool empty() const { return n == 0; }
+
+    T &back() { return n <= N ? items[n - 1] : heap.back(); }
+
+    void push(const T &v) {
+        if (n < N) {
+            items[n] = v;
+        } else {
+            heap.push_back(v);
+        }
+        n++;
+    }
+
+    void pop() {
+        if (n > N) {
+            heap.pop_back();
+        }
+        n--;
+    }
+
+private:
+    T items[N];
+    std::vector<T> heap;
+    size_t n = 0;
+};
+
+// validate the value at `index` and move `index` after it, without recursion.
+// this is the one state machine of all validating parsers, they only differ in handler `h`,
+// which is called with spans of tokens as they are validated:
+//
+//   void onInt(size_t start, size_t end, long long val, bool fits); // digits in [start, end)
+//   void onBytes(size_t start, size_t end, bool isKey);             // content in [start, end)
+//   void onBegin(size_t start, bool isDict);                        // offset of 'l' or 'd'
+//   void onEnd(size_t end);                                         // offset after 'e'
+//
+// `val` is set only if `fits` in long long. dict keys must be sorted and unique if `strict`.
+// on error, `index` is left at the start of the invalid token.
+template <typename H>
+static inline void scanValue(const char *buf, size_t size, size_t &index, H &h, bool strict) {
+    struct Frame {
+        bool isDict;
+        bool wantKey;
+        const char *lastKey;
+        size_t lastKeyLen;
+    };
+
+    SmallStack<Frame, 32> stack;
+
+    while (1) {
+        if (index >= size) {
+            scanErrF("invalid data, unexpected end of buffer. index {}", index);
+        }
+
+        char c = buf[index];
+
+        if (c == 'e' && !stack.empty()) {
+            if (stack.back().isDict && !stack.back().wantKey) {
+                scanErrF("invalid dict, missing value. index {}", index);
+            }
+
+            index++;
+            stack.pop();
+            h.onEnd(index);
+
+            if (stack.empty()) {
+                return;
+            }
+
+            continue;
+        }
+
+        bool isKey = false;
+        if (!stack.empty() && stack.back().isDict) {
+            isKey = stack.back().wantKey;
+            stack.back().wantKey = !isKey;
+        }
+
+        if (isKey && !(c >= '0' && c <= '9')) {
+            scanErrF("invalid dict, key must be bytes. index {}", index);
+        }
+
+        if (c == 'i') {
+            long long val = 0;
+            bool fits;
+            size_t end = scanInt(buf, size, index, val, fits);
+            h.onInt(index + 1, end, val, fits);
+            index = end + 1;
+        } else if (c >= '0' && c <= '9') {
+            size_t tokenStart = index;
+            size_t start = scanBytes(buf, size, index);
+            if (isKey && strict) {
+                Frame &top = stack.back();
+                if (top.lastKey != NULL) {
+                    int r = compareKey(top.lastKey, top.lastKeyLen, buf + start, index - start);
+                    if (r >= 0) {
+                        index = tokenStart;
+                    }
+                    if (r > 0) {
+                        scanErrF("invalid dict, key not sorted. index {}", index);
+                    }
+                    if (r == 0) {
+                        scanErrF("invalid dict, find duplicated keys. index {}", index);
+                    }
+                }
+
+                top.lastKey = buf + start;
+                top.lastKeyLen = index - start;
+            }
+
+            h.onBytes(start, index, isKey);
+        } else if (c == 'l' || c == 'd') {
+            stack.push(Frame{c == 'd', true, NULL, 0});
+            h.onBegin(index, c == 'd');
+            index++;
+            continue;
+        } else {
+            scanErrF("invalid bencode prefix '{:c}', index {}", c, index);
+        }
+
+        if (stack.empty()) {
+            return;
+        }
+    }
+}
+
+// handler of `scanValue` ignoring all tokens.
+struct SkipHandler {
+    void onInt(size_t, size_t, long long, bool) {}
+    void onBytes(size_t, size_t, bool) {}
+    void onBegin(size_t, bool) {}
+    void onEnd(size_t) {}
+};
+
+// validate the value at `index` and move `index` after it, without recursion.
+// on error, `index` is left at the start of the invalid token.
+// dict keys are not required to be sorted and unique if not `strict`.
+static inline void skipValue(const char *buf, size_t size, size_t &index, bool strict = true) {
+    SkipHandler h;
+    scanValue(buf, size, index, h, strict);
+}
+
+// one item of a query path, a dict key or a list index.
+struct PathItem {
+    bool isIndex;
+    size_t index;
+    std::string_view key;
+};
+
+// raw value found by a path, `end` is 0 if it's not found.
+struct PathSpan {
+    size_t start;
+    size_t end;
+};
+
+// validate the value at `index` and move `index` after it.
+// `active` are paths matching up to `depth`, set spans of them found at or inside this value.
+static inline void scanPaths(const char *buf, size_t size, size_t &index,
+                             const std::vector<std::vector<PathItem>> &paths,
+                             const std::vector<size_t> &active, size_t depth,
+                             std::vector<PathSpan> &spans) {
+    size_t valueStart = index;
+
+    // paths continue inside this value
+    std::vector<size_t> deeper;
+    for (size_t i : active) {
+        if (paths[i].size() != depth) {
+            deeper.push_back(i);
+        }
+    }
+
+    if (index >= size) {
+        scanErrF("invalid data, unexpected end of buffer. index {}", index);
+    }
+
+    std::vector<size_t> next;
+
+    if (buf[index] == 'l' && !deeper.empty()) {
+        index++;
+        for (size_t n = 0;; n++) {
+            if (index >= size) {
+                scanErrF("invalid data, buffer overflow when decoding list. index {}", index);
+            }
+
+            if (buf[index] == 'e') {
+                index++;
+                break;
+            }
+
+            next.clear();
+            for (size_t i : deeper) {
+                if (paths[i][depth].isIndex && paths[i][depth].index == n) {
+                    next.push_back(i);
+                }
+            }
+
+            if (next.empty()) {
+                skipValue(buf, size, index);
+            } else {
+                scanPaths(buf, size, index, paths, next, depth + 1, spans);
+            }
+        }
+    } else if (buf[index] == 'd' && !deeper.empty()) {
+        index++;
+        const char *lastKey = NULL;
+        size_t lastKeyLen = 0;
+        while (1) {
+            if (index >= size) {
+                scanErrF("invalid data, buffer overflow end when decoding dict. index {}", index);
+            }
+
+            if (buf[index] == 'e') {
+                index++;
+                break;
+            }
+
+            if (!(buf[index] >= '0' && buf[index] <= '9')) {
+                scanErrF("invalid dict, key must be bytes. index {}", index);
+            }
+
+            size_t tokenStart = index;
+            size_t keyStart = scanBytes(buf, size, index);
+            const char *key = buf + keyStart;
+            size_t keyLen = index - keyStart;
+
+            if (lastKey != NULL) {
+                int r = compareKey(lastKey, lastKeyLen, key, keyLen);
+                if (r > 0) {
+                    scanErrF("invalid dict, key not sorted. index {}", tokenStart);
+                }
+                if (r == 0) {
+                    scanErrF("invalid dict, find duplicated keys. index {}", tokenStart);
+                }
+            }
+
+            lastKey = key;
+            lastKeyLen = keyLen;
+
+            if (index >= size) {
+                scanErrF("invalid data, unexpected end of buffer. index {}", index);
+            }
+
+            if (buf[index] == 'e') {
+                scanErrF("invalid dict, missing value. index {}", index);
+            }
+
+            next.clear();
+            for (size_t i : deeper) {
+                const PathItem &item = paths[i][depth];
+                if (!item.isIndex &&
+                    compareKey(key, keyLen, item.key.data(), item.key.size()) == 0) {
+                    next.push_back(i);
+                }
+            }
+
+            if (next.empty()) {
+                skipValue(buf, size, index);
+            } else {
+                scanPaths(buf, size, index, paths, next, depth + 1, spans);
+            }
+        }
+    } else {
+        // no path goes inside, or type doesn't match path
+        skipValue(buf, size, index);
+    }
+
+    for (size_t i : active) {
+        if (paths[i].size() == depth) {
+            spans[i] = PathSpan{valueStart, index};
+        }
+    }
+}
+
+// validate the whole buffer and find raw values of all `paths` in one pass.
+// values not found have empty span.
+static inline std::vector<PathSpan> findPaths(const char *buf, size_t size,
+                                              const std::vector<std::vector<PathItem>> &paths) {
+    if (size == 0) {
+        throw DecodeError("can't decode empty bytes");
+    }
+
+    std::vector<PathSpan> spans(paths.size(), PathSpan{0, 0});
+    std::vector<size_t> active(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        active[i] = i;
+    }
+
+    size_t index = 0;
+    scanPaths(buf, size, index, paths, active, 0, spans);
+
+    if (index != size) {
+        scanErrF("invalid bencode data, parse end at index {} but total bytes length {}", index,
+                 size);
+    }
+
+    return spans;
+}
+
+// validate the whole buffer, return true and set [start, end) to the raw value at `path`.
+static inline bool findPath(const char *buf, size_t size, const std::vector<PathItem> &path,
+                            size_t &start, size_t &end) {
+    PathSpan span = findPaths(buf, size, {path})[0];
+    start = span.start;
+    end = span.end;
+
+    return end != 0;
+}
+
+// check the whole buffer is exactly one valid value with sorted unique dict keys.
+// return false and set `offset` to the start of the invalid token.
+static inline bool validate(const char *buf, size_t size, size_t &offset) {
+    size_t index = 0;
+
+    try {
+        skipValue(buf, size, index);
+    } catch (DecodeError &) {
+        offset = index;
+        return false;
+    }
+
+    if (index != size) {
+        offset = index;
+        return false;
+    }
+
+    return true;
+}
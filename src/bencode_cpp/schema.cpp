@@ -0,0 +1,536 @@
+#define FMT_HEADER_ONLY
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+#include "scan.h"
+
+namespace py = pybind11;
+
+extern py::object decodeValue(const char *buf, Py_ssize_t *index, Py_ssize_t size,
+                              size_t maxDepth);
+
+#define schemaErrF(f, ...) throw DecodeError(fmt::format(f, ##__VA_ARGS__));
+
+// containers of schema types are decoded with recursion, nesting deeper than this is rejected
+// even with a larger `max_depth` so C stack can't overflow. `Any` values don't recurse.
+#define schemaMaxRecursion 1000
+
+enum SchemaKind {
+    SchemaAny,
+    SchemaInt,
+    SchemaBytes,
+    SchemaStr,
+    SchemaList,
+    SchemaDict,
+    // dataclass or TypedDict
+    SchemaClass,
+};
+
+static const char *kindName(SchemaKind kind) {
+    switch (kind) {
+    case SchemaInt:
+        return "int";
+    case SchemaBytes:
+    case SchemaStr:
+        return "bytes";
+    case SchemaList:
+        return "list";
+    default:
+        return "dict";
+    }
+}
+
+struct SchemaObject;
+
+struct SchemaType {
+    SchemaKind kind;
+    // item of list or value of dict
+    const SchemaType *item = nullptr;
+    // keys of dict are decoded as str
+    bool strKeys = false;
+    const SchemaObject *object = nullptr;
+};
+
+struct SchemaField {
+    // raw key in bencode dict
+    std::string key;
+    // keyword argument of dataclass, or key of TypedDict
+    py::object name;
+    const SchemaType *type;
+    bool required;
+    // Optional[T] without default, pass None if it's missing
+    bool noneIfMissing;
+};
+
+struct SchemaObject {
+    py::object cls;
+    bool typedDict;
+    // sorted by key, to be matched with sorted keys of input
+    std::vector<SchemaField> fields;
+};
+
+// decoder for a type described with type hints, compiled once and reused.
+class Schema {
+public:
+    Schema(py::object tp) {
+        typing = py::module_::import("typing");
+        dataclasses = py::module_::import("dataclasses");
+        root = compile(tp);
+    }
+
+    py::object decode(py::object b, size_t maxDepth) const {
+        Py_buffer view;
+        if (PyObject_GetBuffer(b.ptr(), &view, PyBUF_SIMPLE)) {
+            PyErr_Clear();
+            throw py::type_error("can only decode bytes-like object");
+        }
+
+        auto _ = AutoReleaseBuffer(&view);
+
+        const char *buf = (const char *)view.buf;
+        size_t size = view.len;
+
+        if (size == 0) {
+            throw DecodeError("can't decode empty bytes");
+        }
+
+        statAdd(StatDecodeCalls, 1);
+        statAdd(StatBytesIn, size);
+
+        size_t index = 0;
+        py::object o = decodeAny(buf, size, index, root, 0, maxDepth);
+
+        if (index != size) {
+            schemaErrF("invalid bencode data, parse end at index {} but total bytes length {}",
+                       index, size);
+        }
+
+        return o;
+    }
+
+private:
+    py::object typing;
+    py::object dataclasses;
+    std::vector<std::unique_ptr<SchemaType>> types;
+    std::vector<std::unique_ptr<SchemaObject>> objects;
+    const SchemaType *root;
+
+    SchemaType *newType(SchemaKind kind) {
+        types.push_back(std::make_unique<SchemaType>());
+        types.back()->kind = kind;
+        return types.back().get();
+    }
+
+    // type without None in Optional[T], or nullptr if it's not optional.
+    py::object optionalOf(py::handle tp) {
+        py::object origin = typing.attr("get_origin")(tp);
+        // `X | None` on python 3.10+
+        py::object unionType = py::getattr(py::module_::import("types"), "UnionType", py::none());
+
+        if (!(origin.is(typing.attr("Union")) || (!unionType.is_none() && origin.is(unionType)))) {
+            return py::object();
+        }
+
+        py::object result;
+        for (auto arg : typing.attr("get_args")(tp)) {
+            if (arg.is((PyObject *)Py_TYPE(Py_None))) {
+                continue;
+            }
+
+            if (result) {
+                throw py::type_error(
+                    fmt::format("union type is not supported: {}", std::string(py::repr(tp))));
+            }
+
+            result = py::reinterpret_borrow<py::object>(arg);
+        }
+
+        return result;
+    }
+
+    const SchemaType *compile(py::handle tp) {
+        if (tp.is((PyObject *)&PyLong_Type)) {
+            return newType(SchemaInt);
+        }
+
+        if (tp.is((PyObject *)&PyBytes_Type)) {
+            return newType(SchemaBytes);
+        }
+
+        if (tp.is((PyObject *)&PyUnicode_Type)) {
+            return newType(SchemaStr);
+        }
+
+        if (tp.is(typing.attr("Any"))) {
+            return newType(SchemaAny);
+        }
+
+        py::object inner = optionalOf(tp);
+        if (inner) {
+            return compile(inner);
+        }
+
+        py::object origin = typing.attr("get_origin")(tp);
+        py::tuple args = typing.attr("get_args")(tp);
+
+        if (tp.is((PyObject *)&PyList_Type) || origin.is((PyObject *)&PyList_Type)) {
+            SchemaType *t = newType(SchemaList);
+            t->item = args.size() == 0 ? newType(SchemaAny) : compile(py::object(args[0]));
+            return t;
+        }
+
+        if (tp.is((PyObject *)&PyDict_Type) || origin.is((PyObject *)&PyDict_Type)) {
+            SchemaType *t = newType(SchemaDict);
+            if (args.size() == 0) {
+                t->item = newType(SchemaAny);
+                return t;
+            }
+
+            py::object key = args[0];
+            if (key.is((PyObject *)&PyUnicode_Type)) {
+                t->strKeys = true;
+            } else if (!key.is((PyObject *)&PyBytes_Type)) {
+                throw py::type_error(fmt::format("dict keys must be bytes or str, got {}",
+                                                 std::string(py::repr(key))));
+            }
+
+            t->item = compile(py::object(args[1]));
+            return t;
+        }
+
+        if (PyType_Check(tp.ptr())) {
+            SchemaType *t = newType(SchemaClass);
+            t->object = compileClass(tp);
+            return t;
+        }
+
+        throw py::type_error(fmt::format("unsupported type {}", std::string(py::repr(tp))));
+    }
+
+    const SchemaObject *compileClass(py::handle cls) {
+        for (const auto &o : objects) {
+            if (o->cls.is(cls)) {
+                return o.get();
+            }
+        }
+
+        bool isDataclass = dataclasses.attr("is_dataclass")(cls).cast<bool>();
+        bool isTypedDict = PyType_IsSubtype((PyTypeObject *)cls.ptr(), &PyDict_Type) &&
+                           py::hasattr(cls, "__total__");
+
+        if (!isDataclass && !isTypedDict) {
+            throw py::type_error(
+                fmt::format("unsupported type {}, must be a dataclass or TypedDict",
+                            std::string(py::repr(cls))));
+        }
+
+        // registered before fields, so recursive types refer to itself
+        objects.push_back(std::make_unique<SchemaObject>());
+        SchemaObject *o = objects.back().get();
+        o->cls = py::reinterpret_borrow<py::object>(cls);
+        o->typedDict = isTypedDict;
+
+        py::dict hints = typing.attr("get_type_hints")(cls);
+
+        if (isDataclass) {
+            py::object missing = dataclasses.attr("MISSING");
+            for (auto f : dataclasses.attr("fields")(cls)) {
+                if (!f.attr("init").cast<bool>()) {
+                    continue;
+                }
+
+                py::object name = f.attr("name");
+                py::object key = f.attr("metadata").attr("get")("bencode_key", name);
+                py::object tp = hints[name];
+                bool hasDefault =
+                    !f.attr("default").is(missing) || !f.attr("default_factory").is(missing);
+                bool optional = (bool)optionalOf(tp);
+
+                addField(o, key, name, tp, !hasDefault && !optional, !hasDefault && optional);
+            }
+        } else {
+            py::object required = py::getattr(cls, "__required_keys__", py::none());
+            bool total = py::getattr(cls, "__total__").cast<bool>();
+            for (auto item : hints) {
+                py::object name = py::reinterpret_borrow<py::object>(item.first);
+                bool isRequired = required.is_none() ? total : (bool)required.contains(name);
+                addField(o, name, name, py::reinterpret_borrow<py::object>(item.second),
+                         isRequired, false);
+            }
+        }
+
+        std::sort(o->fields.begin(), o->fields.end(),
+                  [](const SchemaField &a, const SchemaField &b) { return a.key < b.key; });
+
+        for (size_t i = 1; i < o->fields.size(); i++) {
+            if (o->fields[i - 1].key == o->fields[i].key) {
+                throw py::type_error(fmt::format("duplicated key {} in {}", o->fields[i].key,
+                                                 std::string(py::repr(cls))));
+            }
+        }
+
+        return o;
+    }
+
+    void addField(SchemaObject *o, py::handle key, py::object name, py::object tp, bool required,
+                  bool noneIfMissing) {
+        if (!(PyBytes_Check(key.ptr()) || PyUnicode_Check(key.ptr()))) {
+            throw py::type_error("bencode_key must be str or bytes");
+        }
+
+        o->fields.push_back(
+            SchemaField{key.cast<std::string>(), name, compile(tp), required, noneIfMissing});
+    }
+
+    [[noreturn]] static void typeError(const char *buf, size_t index, const SchemaType *t) {
+        schemaErrF("invalid value, expecting {} but found '{:c}'. index {}", kindName(t->kind),
+                   buf[index], index);
+    }
+
+    // container at `index` is nested in `depth` containers, reject it at `maxDepth`.
+    static void checkDepth(size_t index, size_t depth, size_t maxDepth) {
+        if (depth >= maxDepth) {
+            schemaErrF("invalid data, nested too deep, max depth {}. index {}", maxDepth, index);
+        }
+    }
+
+    // schema container at `index` will be decoded with recursion.
+    static void checkRecursion(size_t index, size_t depth, size_t maxDepth) {
+        checkDepth(index, depth, std::min(maxDepth, (size_t)schemaMaxRecursion));
+    }
+
+    static py::object decodeAny(const char *buf, size_t size, size_t &index, const SchemaType *t,
+                                size_t depth, size_t maxDepth) {
+        if (index >= size) {
+            schemaErrF("invalid data, unexpected end of buffer. index {}", index);
+        }
+
+        char c = buf[index];
+
+        switch (t->kind) {
+        case SchemaAny: {
+            Py_ssize_t i = index;
+            if (c == 'l' || c == 'd') {
+                checkDepth(index, depth, maxDepth);
+            }
+            py::object o = decodeValue(buf, &i, size, maxDepth - depth);
+            index = i;
+            return o;
+        }
+        case SchemaInt: {
+            if (c != 'i') {
+                typeError(buf, index, t);
+            }
+
+            long long val;
+            bool fits;
+            size_t end = scanInt(buf, size, index, val, fits);
+            HPy o = fits ? PyLong_FromLongLong(val)
+                         : longFromDigits(buf + index + 1, end - index - 1);
+            if (o == NULL) {
+                throw py::error_already_set();
+            }
+
+            index = end + 1;
+            return py::reinterpret_steal<py::object>(o);
+        }
+        case SchemaBytes:
+        case SchemaStr: {
+            if (!(c >= '0' && c <= '9')) {
+                typeError(buf, index, t);
+            }
+
+            size_t start = scanBytes(buf, size, index);
+            return bytesOrStr(buf + start, index - start, t->kind == SchemaStr);
+        }
+        case SchemaList: {
+            if (c != 'l') {
+                typeError(buf, index, t);
+            }
+
+            checkRecursion(index, depth, maxDepth);
+            index++;
+            py::list l(0);
+            while (1) {
+                if (index >= size) {
+                    schemaErrF("invalid data, buffer overflow when decoding list. index {}",
+                               index);
+                }
+
+                if (buf[index] == 'e') {
+                    index++;
+                    return l;
+                }
+
+                l.append(decodeAny(buf, size, index, t->item, depth + 1, maxDepth));
+            }
+        }
+        case SchemaDict: {
+            if (c != 'd') {
+                typeError(buf, index, t);
+            }
+
+            checkRecursion(index, depth, maxDepth);
+            py::dict d;
+            decodeItems(buf, size, index, [&](const char *key, size_t keyLen) {
+                py::object k = bytesOrStr(key, keyLen, t->strKeys);
+                py::object v = decodeAny(buf, size, index, t->item, depth + 1, maxDepth);
+                if (PyDict_SetItem(d.ptr(), k.ptr(), v.ptr())) {
+                    throw py::error_already_set();
+                }
+            });
+
+            return d;
+        }
+        case SchemaClass:
+            if (c != 'd') {
+                typeError(buf, index, t);
+            }
+
+            checkRecursion(index, depth, maxDepth);
+            return decodeObject(buf, size, index, t->object, depth, maxDepth);
+        }
+
+        return py::object();
+    }
+
+    static py::object bytesOrStr(const char *s, size_t len, bool str) {
+        HPy o = str ? PyUnicode_DecodeUTF8(s, len, NULL) : PyBytes_FromStringAndSize(s, len);
+        if (o == NULL) {
+            throw py::error_already_set();
+        }
+
+        return py::reinterpret_steal<py::object>(o);
+    }
+
+    // call `fn(key, keyLen)` for each key of dict at `index`, it must decode the value.
+    template <typename F>
+    static void decodeItems(const char *buf, size_t size, size_t &index, F fn) {
+        index++;
+        const char *lastKey = NULL;
+        size_t lastKeyLen = 0;
+
+        while (1) {
+            if (index >= size) {
+                schemaErrF("invalid data, buffer overflow end when decoding dict. index {}", index);
+            }
+
+            if (buf[index] == 'e') {
+                index++;
+                return;
+            }
+
+            if (!(buf[index] >= '0' && buf[index] <= '9')) {
+                schemaErrF("invalid dict, key must be bytes. index {}", index);
+            }
+
+            size_t start = scanBytes(buf, size, index);
+            const char *key = buf + start;
+            size_t keyLen = index - start;
+
+            if (lastKey != NULL) {
+                int r = compareKey(lastKey, lastKeyLen, key, keyLen);
+                if (r > 0) {
+                    schemaErrF("invalid dict, key not sorted. index {}", index);
+                }
+                if (r == 0) {
+                    schemaErrF("invalid dict, find duplicated keys. index {}", index);
+                }
+            }
+
+            lastKey = key;
+            lastKeyLen = keyLen;
+
+            if (index >= size) {
+                schemaErrF("invalid data, unexpected end of buffer. index {}", index);
+            }
+
+            if (buf[index] == 'e') {
+                schemaErrF("invalid dict, missing value. index {}", index);
+            }
+
+            fn(key, keyLen);
+        }
+    }
+
+    static py::object decodeObject(const char *buf, size_t size, size_t &index,
+                                   const SchemaObject *o, size_t depth, size_t maxDepth) {
+        const auto &fields = o->fields;
+        std::vector<bool> found(fields.size());
+        py::dict kwargs;
+
+        // both keys and fields are sorted, match them in one pass
+        size_t f = 0;
+        decodeItems(buf, size, index, [&](const char *key, size_t keyLen) {
+            int r = 1;
+            while (f < fields.size()) {
+                r = compareKey(fields[f].key.data(), fields[f].key.size(), key, keyLen);
+                if (r >= 0) {
+                    break;
+                }
+                f++;
+            }
+
+            // unknown key, validate it without building any object
+            if (r != 0) {
+                skipValue(buf, size, index);
+                return;
+            }
+
+            py::object v = decodeAny(buf, size, index, fields[f].type, depth + 1, maxDepth);
+            if (PyDict_SetItem(kwargs.ptr(), fields[f].name.ptr(), v.ptr())) {
+                throw py::error_already_set();
+            }
+            found[f] = true;
+        });
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (found[i]) {
+                continue;
+            }
+
+            if (fields[i].required) {
+                schemaErrF("missing required key {} of {}. index {}", fields[i].key,
+                           std::string(py::str(o->cls.attr("__name__"))), index);
+            }
+
+            if (fields[i].noneIfMissing) {
+                if (PyDict_SetItem(kwargs.ptr(), fields[i].name.ptr(), Py_None)) {
+                    throw py::error_already_set();
+                }
+            }
+        }
+
+        if (o->typedDict) {
+            return std::move(kwargs);
+        }
+
+        HPy args = PyTuple_New(0);
+        if (args == NULL) {
+            throw py::error_already_set();
+        }
+        auto _0 = AutoFree(args);
+
+        HPy obj = PyObject_Call(o->cls.ptr(), args, kwargs.ptr());
+        if (obj == NULL) {
+            throw py::error_already_set();
+        }
+
+        return py::reinterpret_steal<py::object>(obj);
+    }
+};
+
+void registerSchemaType(py::module_ &m) {
+    py::class_<Schema>(m, "Schema")
+        .def(py::init<py::object>(), py::arg("tp"))
+        .def("decode", &Schema::decode, py::arg("b"), py::pos_only(), py::kw_only(),
+             py::arg("max_depth") = defaultMaxDepth);
+}
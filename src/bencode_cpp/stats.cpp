@@ -0,0 +1,73 @@
+#include <pybind11/pybind11.h>
+
+#include "common.h"
+
+namespace py = pybind11;
+
+// counters since module is loaded or `reset_stats()`, empty if built without BENCODE_CPP_STATS.
+static py::dict stats() {
+    py::dict d;
+
+#ifdef BENCODE_CPP_STATS
+    for (size_t i = 0; i < StatCount; i++) {
+        d[statNames[i]] = statCounters[i].load(std::memory_order_relaxed);
+    }
+#endif
+
+    return d;
+}
+
+static void reset_stats() {
+#ifdef BENCODE_CPP_STATS
+    for (auto &c : statCounters) {
+        c.store(0, std::memory_order_relaxed);
+    }
+#endif
+}
+
+#ifdef BENCODE_CPP_STATS
+// count exceptions raised to python by type, then pass them to other translators.
+static void countException(std::exception_ptr p) {
+    try {
+        std::rethrow_exception(p);
+    } catch (DecodeError &) {
+        statAdd(StatDecodeErrors, 1);
+        throw;
+    } catch (EncodeError &) {
+        statAdd(StatEncodeErrors, 1);
+        throw;
+    } catch (py::type_error &) {
+        statAdd(StatTypeErrors, 1);
+        throw;
+    } catch (py::value_error &) {
+        statAdd(StatValueErrors, 1);
+        throw;
+    } catch (py::error_already_set &e) {
+        if (e.matches(BencodeDecodeErrorType)) {
+            statAdd(StatDecodeErrors, 1);
+        } else if (e.matches(BencodeEncodeErrorType)) {
+            statAdd(StatEncodeErrors, 1);
+        } else if (e.matches(PyExc_TypeError)) {
+            statAdd(StatTypeErrors, 1);
+        } else if (e.matches(PyExc_ValueError)) {
+            statAdd(StatValueErrors, 1);
+        } else {
+            statAdd(StatOtherErrors, 1);
+        }
+        throw;
+    } catch (...) {
+        statAdd(StatOtherErrors, 1);
+        throw;
+    }
+}
+#endif
+
+void registerStats(py::module_ &m) {
+    m.def("stats", &stats, "");
+    m.def("reset_stats", &reset_stats, "");
+
+#ifdef BENCODE_CPP_STATS
+    // module local translators are tried before the global ones converting exceptions
+    py::register_local_exception_translator(countException);
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// counters of calls and hot paths, for metrics in production.
+//
+// they are compiled in only when BENCODE_CPP_STATS is defined, otherwise `statAdd` is a no-op
+// and default build pays nothing. counters are relaxed atomics shared by all threads.
+
+#include <atomic>
+#include <cstdint>
+
+enum StatCounter {
+    StatEncodeCalls,
+    StatDecodeCalls,
+    StatBytesIn,
+    StatBytesOut,
+    StatPoolHits,
+    StatPoolMisses,
+    StatBufferGrows,
+    StatEncodeBigInts,
+    StatDecodeBigInts,
+    StatDecodeErrors,
+    StatEncodeErrors,
+    StatTypeErrors,
+    StatValueErrors,
+    StatOtherErrors,
+    StatCount,
+};
+
+// names of counters, in order of StatCounter
+inline const char *const statNames[StatCount] = {
+    "encode_calls",
+    "decode_calls",
+    "bytes_in",
+    "bytes_out",
+    "pool_hits",
+    "pool_misses",
+    "buffer_grows",
+    "encode_big_ints",
+    "decode_big_ints",
+    "decode_errors",
+    "encode_errors",
+    "type_errors",
+    "value_errors",
+    "other_errors",
+};
+
+#ifdef BENCODE_CPP_STATS
+
+inline std::atomic<uint64_t> statCounters[StatCount];
+
+#define statAdd(counter, n) statCounters[counter].fetch_add((n), std::memory_order_relaxed)
+
+#else
+
+#define statAdd(counter, n)                                                                        \
+    do {                                                                                           \
+    } while (0)
+
+#endif
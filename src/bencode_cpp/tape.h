@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base.h"
+#include "scan.h"
+
+// a flat structural index of a bencode buffer.
+// each value is one entry, container children follow their parent entry in order,
+// dict children alternate between key and value.
+
+enum TapeKind : uint8_t {
+    TapeInt,
+    TapeBytes,
+    TapeList,
+    TapeDict,
+};
+
+struct TapeEntry {
+    TapeKind kind;
+    // index of the first entry after this value, jump over containers without walking them.
+    uint32_t next;
+    // int: offset after 'i', bytes: offset of content, list/dict: offset of 'l'/'d'
+    size_t start;
+    // int: offset of 'e', bytes: end of content, list/dict: offset after the closing 'e'
+    size_t end;
+};
+
+class Tape {
+public:
+    std::vector<TapeEntry> entries;
+
+    // build index of `buf`, validate it with the same rules as `bdecode`.
+    void build(const char *buf, size_t size) {
+        entries.clear();
+
+        if (size == 0) {
+            throw DecodeError("can't decode empty bytes");
+        }
+
+        Builder b{entries, {}};
+        size_t index = 0;
+        scanValue(buf, size, index, b, true);
+
+        if (index != size) {
+            scanErrF("invalid bencode data, parse end at index {} but total bytes length {}",
+                     index, size);
+        }
+    }
+
+private:
+    // `scanValue` handler appending entries
+    struct Builder {
+        std::vector<TapeEntry> &entries;
+        // entries of open containers
+        std::vector<uint32_t> open;
+
+        void onInt(size_t start, size_t end, long long, bool) { add(TapeInt, start, end); }
+
+        void onBytes(size_t start, size_t end, bool) { add(TapeBytes, start, end); }
+
+        void onBegin(size_t start, bool isDict) {
+            open.push_back((uint32_t)entries.size());
+            entries.push_back(TapeEntry{isDict ? TapeDict : TapeList, 0, start, 0});
+        }
+
+        void onEnd(size_t end) {
+            TapeEntry &e = entries[open.back()];
+            open.pop_back();
+            e.end = end;
+            e.next = (uint32_t)entries.size();
+        }
+
+        void add(TapeKind kind, size_t start, size_t end) {
+            uint32_t entry = (uint32_t)entries.size();
+            entries.push_back(TapeEntry{kind, entry + 1, start, end});
+        }
+    };
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "base.h"
+#include "ctx.h"
+#include "sax.h"
+
+// native bencode value, for C++ users of the core library.
+
+class Value;
+
+using ValueList = std::vector<Value>;
+
+// dict items, sorted by key after decoding, sorted when encoding.
+using ValueDict = std::vector<std::pair<std::string, Value>>;
+
+// int out of long long range, kept as decimal digits.
+struct BigInt {
+    std::string digits;
+
+    bool operator==(const BigInt &o) const { return digits == o.digits; }
+};
+
+class Value {
+public:
+    std::variant<long long, BigInt, std::string, ValueList, ValueDict> v;
+
+    Value() : v(0LL) {}
+    Value(int i) : v((long long)i) {}
+    Value(long long i) : v(i) {}
+    Value(BigInt i) : v(std::move(i)) {}
+    Value(const char *s) : v(std::string(s)) {}
+    Value(std::string_view s) : v(std::string(s)) {}
+    Value(std::string s) : v(std::move(s)) {}
+    Value(ValueList l) : v(std::move(l)) {}
+    Value(ValueDict d) : v(std::move(d)) {}
+
+    Value(const Value &) = default;
+    Value(Value &&) = default;
+    Value &operator=(const Value &) = default;
+    Value &operator=(Value &&) = default;
+
+    // free nested values without recursion, deep trees can't overflow C stack.
+    ~Value() {
+        if (!isList() && !isDict()) {
+            return;
+        }
+
+        std::vector<Value> pending;
+        takeChildren(pending);
+        while (!pending.empty()) {
+            Value child = std::move(pending.back());
+            pending.pop_back();
+            child.takeChildren(pending);
+        }
+    }
+
+    bool isInt() const { return std::holds_alternative<long long>(v); }
+    bool isBigInt() const { return std::holds_alternative<BigInt>(v); }
+    bool isBytes() const { return std::holds_alternative<std::string>(v); }
+    bool isList() const { return std::holds_alternative<ValueList>(v); }
+    bool isDict() const { return std::holds_alternative<ValueDict>(v); }
+
+    // throw std::bad_variant_access if type doesn't match.
+    long long asInt() const { return std::get<long long>(v); }
+    const BigInt &asBigInt() const { return std::get<BigInt>(v); }
+    const std::string &asBytes() const { return std::get<std::string>(v); }
+    const ValueList &asList() const { return std::get<ValueList>(v); }
+    const ValueDict &asDict() const { return std::get<ValueDict>(v); }
+
+    // value of `key` in dict, nullptr if not found or this is not a dict.
+    const Value *find(std::string_view key) const {
+        const ValueDict *d = std::get_if<ValueDict>(&v);
+        if (d == nullptr) {
+            return nullptr;
+        }
+
+        for (const auto &item : *d) {
+            if (item.first == key) {
+                return &item.second;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool operator==(const Value &o) const { return v == o.v; }
+
+    bool operator!=(const Value &o) const { return !(v == o.v); }
+
+    // decode and validate `buf`, throw DecodeError on invalid data or nesting deeper than
+    // `maxDepth`.
+    static Value decode(std::string_view buf, size_t maxDepth = defaultMaxDepth);
+
+    // throw EncodeError on duplicated dict keys.
+    std::string encode() const {
+        Context ctx;
+        encodeTo(&ctx);
+        return std::string(ctx.buf, ctx.index);
+    }
+
+    // encode without recursion, containers being written are kept in an explicit stack.
+    void encodeTo(Context *ctx) const {
+        std::vector<EncodeFrame> stack;
+        const Value *next = this;
+
+        while (1) {
+            if (next != nullptr) {
+                next->encodeOne(ctx, stack);
+            }
+
+            if (stack.empty()) {
+                return;
+            }
+
+            EncodeFrame &top = stack.back();
+            next = nullptr;
+            if (top.list != nullptr) {
+                if (top.index < top.list->size()) {
+                    next = &(*top.list)[top.index++];
+                }
+            } else if (top.index < top.items.size()) {
+                const auto *item = top.items[top.index++];
+                writeBytes(ctx, item->first);
+                next = &item->second;
+            }
+
+            if (next == nullptr) {
+                ctx->writeChar('e');
+                stack.pop_back();
+            }
+        }
+    }
+
+private:
+    // a list, or sorted items of a dict, being encoded
+    struct EncodeFrame {
+        const ValueList *list;
+        std::vector<const std::pair<std::string, Value> *> items;
+        size_t index;
+    };
+
+    static void writeBytes(Context *ctx, const std::string &s) {
+        ctx->writeSize_t(s.size());
+        ctx->writeChar(':');
+        ctx->write(s.data(), s.size());
+    }
+
+    // write a scalar, or write start of a container and push it to `stack`.
+    void encodeOne(Context *ctx, std::vector<EncodeFrame> &stack) const {
+        if (const long long *i = std::get_if<long long>(&v)) {
+            ctx->writeChar('i');
+            ctx->writeLongLong(*i);
+            ctx->writeChar('e');
+            return;
+        }
+
+        if (const BigInt *i = std::get_if<BigInt>(&v)) {
+            ctx->writeChar('i');
+            ctx->write(i->digits.data(), i->digits.size());
+            ctx->writeChar('e');
+            return;
+        }
+
+        if (const std::string *s = std::get_if<std::string>(&v)) {
+            writeBytes(ctx, *s);
+            return;
+        }
+
+        if (const ValueList *l = std::get_if<ValueList>(&v)) {
+            ctx->writeChar('l');
+            stack.push_back(EncodeFrame{l, {}, 0});
+            return;
+        }
+
+        const ValueDict &d = std::get<ValueDict>(v);
+
+        std::vector<const std::pair<std::string, Value> *> items;
+        items.reserve(d.size());
+        for (const auto &item : d) {
+            items.push_back(&item);
+        }
+
+        auto less = [](const std::pair<std::string, Value> *a,
+                       const std::pair<std::string, Value> *b) { return a->first < b->first; };
+
+        if (!std::is_sorted(items.begin(), items.end(), less)) {
+            std::sort(items.begin(), items.end(), less);
+        }
+
+        for (size_t i = 1; i < items.size(); i++) {
+            if (items[i - 1]->first == items[i]->first) {
+                throw EncodeError(fmt::format("found duplicated keys {}", items[i]->first));
+            }
+        }
+
+        ctx->writeChar('d');
+        stack.push_back(EncodeFrame{nullptr, std::move(items), 0});
+    }
+
+    // move nested values out to `pending`, leaving this container empty.
+    void takeChildren(std::vector<Value> &pending) {
+        if (ValueList *l = std::get_if<ValueList>(&v)) {
+            for (auto &item : *l) {
+                pending.push_back(std::move(item));
+            }
+            l->clear();
+        } else if (ValueDict *d = std::get_if<ValueDict>(&v)) {
+            for (auto &item : *d) {
+                pending.push_back(std::move(item.second));
+            }
+            d->clear();
+        }
+    }
+};
+
+// sax visitor building a value tree.
+class ValueBuilder {
+public:
+    Value result;
+    size_t maxDepth = defaultMaxDepth;
+
+    void onInt(long long val) { add(Value(val)); }
+    void onBigInt(std::string_view digits) { add(Value(BigInt{std::string(digits)})); }
+    void onBytes(std::string_view s) { add(Value(s)); }
+    void onKey(std::string_view key) { stack.back().key = std::string(key); }
+    void onListBegin() { push(Value(ValueList())); }
+    void onDictBegin() { push(Value(ValueDict())); }
+
+    void onEnd() {
+        Value done = std::move(stack.back().value);
+        stack.pop_back();
+        add(std::move(done));
+    }
+
+private:
+    struct Frame {
+        Value value;
+        std::string key;
+    };
+
+    std::vector<Frame> stack;
+
+    void push(Value v) {
+        if (stack.size() >= maxDepth) {
+            throw DecodeError(fmt::format("invalid data, nested too deep, max depth {}", maxDepth));
+        }
+
+        stack.push_back(Frame{std::move(v), std::string()});
+    }
+
+    void add(Value v) {
+        if (stack.empty()) {
+            result = std::move(v);
+            return;
+        }
+
+        Frame &f = stack.back();
+        if (ValueList *l = std::get_if<ValueList>(&f.value.v)) {
+            l->push_back(std::move(v));
+        } else {
+            std::get<ValueDict>(f.value.v).emplace_back(std::move(f.key), std::move(v));
+        }
+    }
+};
+
+inline Value Value::decode(std::string_view buf, size_t maxDepth) {
+    ValueBuilder b;
+    b.maxDepth = maxDepth;
+    saxParse(buf, b);
+    return std::move(b.result);
+}
@@ -1,12 +1,23 @@
 from __future__ import annotations
 
 import collections
+from concurrent.futures import ThreadPoolExecutor
+import io
+import os
+from pathlib import Path
 from typing import Any
 import types
 
 import pytest
 
-from bencode_cpp import BencodeEncodeError, bencode
+from bencode_cpp import (
+    BencodeEncodeError,
+    bencode,
+    bencode_into,
+    bencode_to,
+    bencoded_size,
+    configure_pool,
+)
 
 
 def test_exception_when_strict():
@@ -116,6 +127,22 @@ def test_duplicated_type_keys():
         bencode({"string_key": 1, b"string_key": 2, "1": 2})
 
 
+def test_dict_key_order():
+    assert bencode({"b": 1, "a": 2, b"c": 3}) == b"d1:ai2e1:bi1e1:ci3ee"
+    assert bencode({"a": 1, "b": 2}) == b"d1:ai1e1:bi2ee"
+    # sorted by utf-8 bytes, not by code points
+    assert (
+        bencode({"\uffff": 1, "\U00010000": 2})
+        == b"d3:\xef\xbf\xbfi1e4:\xf0\x90\x80\x80i2ee"
+    )
+
+    with pytest.raises(BencodeEncodeError):
+        bencode({"b": 1, b"a": 2, "a": 3})
+
+    with pytest.raises(UnicodeEncodeError):
+        bencode({"\udc80": 1})
+
+
 def test_dict_int_keys():
     with pytest.raises(BencodeEncodeError):
         bencode({1: 2})
@@ -144,6 +171,10 @@ def test_dict_int_keys():
         # slow path overflow c long long
         (9223372036854775808, b"i9223372036854775808e"),  # longlong int +1
         (18446744073709551616, b"i18446744073709551616e"),  # unsigned long long +1
+        (-9223372036854775809, b"i-9223372036854775809e"),  # longlong int -1
+        (9223372036854775807, b"i9223372036854775807e"),
+        (-9223372036854775808, b"i-9223372036854775808e"),
+        (10**200, b"i1" + b"0" * 200 + b"e"),
     ],
     ids=lambda val: f"raw={val[0]!r} expected={val[1]!r}",
 )
@@ -175,3 +206,176 @@ def test_recursive_object():
     d["a"] = d
     with pytest.raises(ValueError, match="circular reference found"):
         assert bencode(d.copy())
+
+
+def test_max_depth():
+    assert bencode([[{"a": (1,)}]], max_depth=4) == b"lld1:ali1eeeee"
+
+    with pytest.raises(BencodeEncodeError):
+        bencode([[{"a": (1,)}]], max_depth=3)
+
+    depth = 100000
+    v: list = []
+    for _ in range(depth - 1):
+        v = [v]
+
+    with pytest.raises(BencodeEncodeError):
+        bencode(v)
+
+    assert bencode(v, max_depth=depth) == b"l" * depth + b"e" * depth
+
+
+def test_exact_size():
+    values = [
+        0,
+        -(2**63),
+        10**200,
+        "",
+        "中文",
+        b"x" * 100000,
+        bytearray(b"spam"),
+        {"b": [1, (2, b"c")], b"a": {}},
+        types.MappingProxyType({"a": 1}),
+        [[[]]],
+    ]
+
+    for v in values:
+        expected = bencode(v)
+        assert bencoded_size(v) == len(expected)
+        assert bencode(v, exact_size=True) == expected
+
+    with pytest.raises(TypeError):
+        bencoded_size([None])
+
+    with pytest.raises(BencodeEncodeError):
+        bencode([[1]], max_depth=1, exact_size=True)
+
+
+def test_configure_pool():
+    v = {"a": [b"x" * 100000, 1]}
+    expected = bencode(v)
+
+    try:
+        for args in [(0, 64, 64), (1, 64, 1024), (2, 1 << 20, 1 << 30)]:
+            configure_pool(*args)
+            for _ in range(20):
+                assert bencode(v) == expected
+                assert bencode(1) == b"i1e"
+    finally:
+        configure_pool()
+
+    with pytest.raises(ValueError):
+        configure_pool(initial_size=0)
+
+    with pytest.raises(ValueError):
+        configure_pool(initial_size=4096, max_retained=1024)
+
+    # rejected limits are not applied
+    assert bencode(v) == expected
+
+
+def test_encode_to_file():
+    v = {b"a": [b"x" * 1000, 1, {"b": "c" * 10}], "d": list(range(1000))}
+    expected = bencode(v)
+
+    for size in [0, 64, 100, 4096, 1 << 20]:
+        f = io.BytesIO()
+        assert bencode_to(v, f, buffer_size=size) == len(expected)
+        assert f.getvalue() == expected
+
+
+def test_encode_to_fd(tmp_path: Path):
+    v = [b"x" * 100000, {"a": 1}]
+    p = tmp_path.joinpath("a.bin")
+    with p.open("wb") as f:
+        assert bencode_to(v, f.fileno(), buffer_size=1024) == len(bencode(v))
+
+    assert p.read_bytes() == bencode(v)
+
+
+def test_encode_to_raw_file(tmp_path: Path):
+    v = [b"x" * 100000, {"a": 1}]
+    p = tmp_path.joinpath("a.bin")
+    with p.open("wb", buffering=0) as f:
+        assert bencode_to(v, f) == len(bencode(v))
+
+    assert p.read_bytes() == bencode(v)
+
+
+def test_encode_to_error(tmp_path: Path):
+    with pytest.raises(TypeError):
+        bencode_to(None, io.BytesIO())
+
+    r, w = os.pipe()
+    os.close(w)
+    os.close(r)
+    with pytest.raises(OSError):
+        bencode_to(1, w)
+
+    class Stuck:
+        def write(self, b: bytes) -> int:
+            return 0
+
+    with pytest.raises(OSError):
+        bencode_to(b"spam", Stuck())
+
+
+def test_encode_to_max_depth():
+    v = [[{"a": (1,)}]]
+
+    f = io.BytesIO()
+    assert bencode_to(v, f, max_depth=4) == 14
+    assert f.getvalue() == b"lld1:ali1eeeee"
+
+    with pytest.raises(BencodeEncodeError):
+        bencode_to(v, io.BytesIO(), max_depth=3)
+
+    buf = bytearray(14)
+    assert bencode_into(v, buf, max_depth=4) == 14
+    assert buf == b"lld1:ali1eeeee"
+
+    with pytest.raises(BencodeEncodeError):
+        bencode_into(v, buf, max_depth=3)
+
+
+def test_encode_into():
+    v = {b"a": [b"x" * 1000, 1, {"b": "c" * 10}], "d": list(range(1000))}
+    expected = bencode(v)
+
+    buf = bytearray(len(expected) + 10)
+    assert bencode_into(v, buf) == len(expected)
+    assert buf[: len(expected)] == expected
+
+    assert bencode_into(v, buf, offset=10) == len(expected)
+    assert buf[10:] == expected
+
+    buf = bytearray(5)
+    assert bencode_into(b"ab", memoryview(buf)[1:]) == 4
+    assert buf == b"\x002:ab"
+
+
+def test_encode_into_error():
+    with pytest.raises(ValueError, match="need 6 bytes"):
+        bencode_into(b"spam", bytearray(5))
+
+    with pytest.raises(ValueError):
+        bencode_into(b"spam", bytearray(10), offset=11)
+
+    with pytest.raises(TypeError):
+        bencode_into(b"spam", b"readonly buffer")
+
+
+def test_encode_threads():
+    values = [
+        {b"a": [b"x" * i, i, {"b": "c" * i}], "d": list(range(i))} for i in range(50)
+    ]
+    expected = [bencode(v) for v in values]
+
+    def worker(n: int) -> None:
+        for _ in range(200):
+            for v, e in zip(values, expected):
+                assert bencode(v) == e
+
+    with ThreadPoolExecutor(max_workers=8) as pool:
+        for f in [pool.submit(worker, n) for n in range(16)]:
+            f.result()
@@ -1,8 +1,15 @@
+import mmap
 from typing import Any
 
 import pytest
 
-from bencode_cpp import BencodeDecodeError, bdecode
+from bencode_cpp import (
+    BencodeDecodeError,
+    bdecode,
+    bdecode_many,
+    bvalidate,
+    intern_keys,
+)
 
 
 def test_non_bytes_input():
@@ -13,6 +20,28 @@ def test_non_bytes_input():
         bdecode(1)  # type: ignore
 
 
+def test_buffer_input():
+    assert bdecode(bytearray(b"d4:spaml1:a1:bee")) == {b"spam": [b"a", b"b"]}
+    assert bdecode(memoryview(b"xxl4:spam4:eggseyy")[2:-2]) == [b"spam", b"eggs"]
+
+    # slice must not be read past its end
+    with pytest.raises(BencodeDecodeError):
+        bdecode(memoryview(b"le")[:1])
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode(memoryview(b"d1:ai1ee")[:4])
+
+    with pytest.raises(TypeError):
+        bdecode(memoryview(b"l4:spam4:eggse")[::2])
+
+
+def test_mmap_input(tmp_path):
+    p = tmp_path.joinpath("a.bin")
+    p.write_bytes(b"d3:cow3:mooe")
+    with p.open("rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as m:
+        assert bdecode(m) == {b"cow": b"moo"}
+
+
 @pytest.mark.parametrize(
     ["raw", "expected"],
     [
@@ -21,6 +50,12 @@ def test_non_bytes_input():
         (b"i-123e", -123),
         (b"i20022e", 20022),
         (b"i-20022e", -20022),
+        (b"i9223372036854775807e", 9223372036854775807),
+        (b"i-9223372036854775808e", -9223372036854775808),
+        (b"i9223372036854775808e", 9223372036854775808),
+        (b"i-18446744073709551616e", -18446744073709551616),
+        (b"i12345678901234567890123456789e", 12345678901234567890123456789),
+        (b"i-1" + b"0" * 200 + b"e", -(10**200)),
     ],
 )
 def test_decode_int(raw, expected):
@@ -72,12 +107,73 @@ def test_decode_str():
         # directory keys not sorted for {'foo': 1, 'spam': 2}
         b"d3:foo4:spam3:bari42e",
         b"d3:foo4:spam3:bari42ee",
+        b"d3:fooi1e3:fooi2ee",  # duplicated keys
+        b"di1ei2ee",  # non-bytes key
+        b"d3:fooe",  # missing value
     ],
 )
 def test_bad_case(raw: bytes):
     with pytest.raises(BencodeDecodeError):
         bdecode(raw)
 
+    offset = bvalidate(raw)
+    assert offset is not None
+    assert 0 <= offset <= len(raw)
+
+
+def test_validate():
+    assert (
+        bvalidate(b"d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe") is None
+    )
+    assert bvalidate(memoryview(b"l" * 10000 + b"e" * 10000)) is None
+    assert bvalidate(b"") == 0
+    assert bvalidate(b"i-0e") == 0
+    assert bvalidate(b"li1ei01ee") == 4
+    assert bvalidate(b"i1ei2e") == 3
+
+    # offset is the start of the invalid token
+    assert bvalidate(b"l") == 1
+    assert bvalidate(b"x") == 0
+    assert bvalidate(b"5:abc") == 0
+    assert bvalidate(b"d1:ae") == 4
+    assert bvalidate(b"di1ei2ee") == 1
+    assert bvalidate(b"d1:bi1e1:ai1ee") == 7
+    assert bvalidate(b"d1:ai1e1:ai1ee") == 7
+    assert bvalidate(b"ld1:bi1e12:aaaaaaaaaaaai1eee") == 8
+
+    with pytest.raises(TypeError):
+        bvalidate("i1e")  # type: ignore
+
+
+def test_not_strict():
+    assert bdecode(b"d3:foo4:spam3:bari42ee", strict=False) == {
+        b"foo": b"spam",
+        b"bar": 42,
+    }
+    assert bdecode(b"d3:fooi1e3:fooi2ee", strict=False) == {b"foo": 2}
+
+    # structure is still validated
+    for raw in [b"di1ei2ee", b"d3:fooe", b"d3:fooi1e"]:
+        with pytest.raises(BencodeDecodeError):
+            bdecode(raw, strict=False)
+
+
+def test_max_depth():
+    assert bdecode(b"lld1:ai1eeee", max_depth=3) == [[{b"a": 1}]]
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode(b"lld1:ai1eeee", max_depth=2)
+
+    # hostile input is rejected without exhausting C stack
+    with pytest.raises(BencodeDecodeError):
+        bdecode(b"l" * 1000000 + b"e" * 1000000)
+
+    depth = 100000
+    v = bdecode(b"l" * depth + b"e" * depth, max_depth=depth)
+    for _ in range(depth - 1):
+        (v,) = v
+    assert v == []
+
 
 @pytest.mark.parametrize(
     ["raw", "expected"],
@@ -125,6 +221,34 @@ def test_decode1():
     }
 
 
+def test_shared_keys():
+    a, b = bdecode(b"ld6:lengthi1eed6:lengthi2eee")
+    assert next(iter(a)) is next(iter(b))
+
+    long_key = b"k" * 100
+    a, b = bdecode(b"ld100:" + long_key + b"i1eed100:" + long_key + b"i2eee")
+    assert a == {long_key: 1}
+    assert b == {long_key: 2}
+
+
+def test_intern_keys():
+    key = b"length"
+    intern_keys([key])
+    try:
+        assert next(iter(bdecode(b"d6:lengthi1ee"))) is key
+        assert next(iter(bdecode_many([b"d6:lengthi1ee"])[0])) is key
+    finally:
+        intern_keys([])
+
+    assert next(iter(bdecode(b"d6:lengthi1ee"))) is not key
+
+    with pytest.raises(TypeError):
+        intern_keys(["length"])  # type: ignore
+
+    with pytest.raises(ValueError):
+        intern_keys([b"k" * 100])
+
+
 #
 #
 # @pytest.mark.parametrize(
@@ -1,7 +1,23 @@
 import hashlib
 from pathlib import Path
 
-from bencode_cpp import bdecode, bencode
+import pytest
+
+from bencode_cpp import (
+    BencodeDecodeError,
+    BencodeRaw,
+    bdecode,
+    bdecode_file,
+    bdecode_path,
+    bdecode_paths,
+    bencode,
+    info_hash,
+    raw_value,
+)
+
+fixture = Path(__file__).joinpath(
+    "../fixtures/ubuntu-22.04.2-desktop-amd64.iso.torrent.bin"
+).resolve()
 
 
 def test_get_torrent_info_hash():
@@ -16,3 +32,200 @@ def test_get_torrent_info_hash():
             hashlib.sha1(bencode(data[b"info"])).hexdigest()
             == "a7838b75c42b612da3b6cc99beed4ecb2d04cff2"
         )
+
+
+def test_decode_file():
+    assert bdecode_file(fixture) == bdecode(fixture.read_bytes())
+    assert bdecode_file(str(fixture)) == bdecode(fixture.read_bytes())
+    assert bdecode_file(fixture, strict=False) == bdecode(fixture.read_bytes())
+
+
+def test_decode_file_error(tmp_path: Path):
+    with pytest.raises(FileNotFoundError):
+        bdecode_file(tmp_path.joinpath("missing.torrent"))
+
+    empty = tmp_path.joinpath("empty.torrent")
+    empty.write_bytes(b"")
+    with pytest.raises(BencodeDecodeError):
+        bdecode_file(empty)
+
+    bad = tmp_path.joinpath("bad.torrent")
+    bad.write_bytes(b"d4:spam")
+    with pytest.raises(BencodeDecodeError):
+        bdecode_file(bad)
+
+
+def test_info_hash():
+    raw = fixture.read_bytes()
+    assert info_hash(raw).hex() == "a7838b75c42b612da3b6cc99beed4ecb2d04cff2"
+    assert (
+        info_hash(memoryview(raw)) == hashlib.sha1(raw_value(raw, [b"info"])).digest()
+    )
+    assert (
+        info_hash(raw, v2=True)
+        == hashlib.sha256(bencode(bdecode(raw)[b"info"])).digest()
+    )
+
+    with pytest.raises(KeyError):
+        info_hash(b"d4:spami1ee")
+
+    with pytest.raises(BencodeDecodeError):
+        info_hash(b"d4:infoi1ee")
+
+    with pytest.raises(BencodeDecodeError):
+        info_hash(raw[:-1])
+
+
+def test_raw_value():
+    raw = fixture.read_bytes()
+    data = bdecode(raw)
+
+    assert raw_value(raw, [b"info"]) == bencode(data[b"info"])
+    assert raw_value(raw, ["info", "name"]) == bencode(data[b"info"][b"name"])
+    assert raw_value(raw, [b"announce-list", 1, 0]) == bencode(
+        data[b"announce-list"][1][0]
+    )
+    assert raw_value(raw, []) == raw
+
+    with pytest.raises(KeyError):
+        raw_value(raw, [b"info", b"missing"])
+
+    with pytest.raises(KeyError):
+        raw_value(raw, [b"announce-list", 100])
+
+
+def test_decode_path():
+    raw = fixture.read_bytes()
+    data = bdecode(raw)
+
+    assert bdecode_path(raw, [b"info", b"name"]) == data[b"info"][b"name"]
+    assert bdecode_path(raw, ["info", "piece length"]) == data[b"info"][b"piece length"]
+    assert bdecode_path(raw, [b"announce-list", 1]) == data[b"announce-list"][1]
+    assert bdecode_path(raw, []) == data
+
+    with pytest.raises(KeyError):
+        bdecode_path(raw, [b"info", b"missing"])
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode_path(raw[:-1], [b"info", b"name"])
+
+    assert bdecode_paths(
+        raw,
+        [
+            [b"info", b"name"],
+            [b"announce-list", 0, 0],
+            [b"info", b"missing"],
+            [b"announce-list", 100],
+            [b"info"],
+        ],
+    ) == [
+        data[b"info"][b"name"],
+        data[b"announce-list"][0][0],
+        None,
+        None,
+        data[b"info"],
+    ]
+
+    assert bdecode_paths(raw, [[b"missing"]], default=0) == [0]
+    assert bdecode_paths(raw, []) == []
+
+    # a single key is not a key path
+    for path in [b"info", "info", bytearray(b"info")]:
+        with pytest.raises(TypeError):
+            bdecode_path(raw, path)
+
+        with pytest.raises(TypeError):
+            bdecode_paths(raw, [path])
+
+    # bool is an int subclass, but never a list index
+    with pytest.raises(TypeError):
+        bdecode_path(raw, [b"announce-list", True])
+
+    with pytest.raises(TypeError):
+        bdecode_paths(raw, [[b"announce-list", False]])
+
+
+def test_decode_path_max_depth():
+    # depth counts from the found value, not from the document root
+    raw = b"d1:alli1eeee"
+
+    assert bdecode_path(raw, [b"a"], max_depth=2) == [[1]]
+    assert bdecode_paths(raw, [[b"a"]], max_depth=2) == [[[1]]]
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode_path(raw, [b"a"], max_depth=1)
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode_paths(raw, [[b"a"]], max_depth=1)
+
+
+def test_raw_keys():
+    raw = fixture.read_bytes()
+
+    data = bdecode(raw, raw_keys=[b"info"])
+    assert isinstance(data[b"info"], BencodeRaw)
+    assert bytes(data[b"info"]) == raw_value(raw, [b"info"])
+    assert bencode(data) == raw
+
+    data[b"comment"] = b"rewritten"
+    data[b"announce"] = "https://tracker.example.com/announce"
+    rewritten = bencode(data)
+    assert info_hash(rewritten) == info_hash(raw)
+    assert bdecode(rewritten)[b"comment"] == b"rewritten"
+
+    assert bdecode_file(fixture, raw_keys=["info"]) == bdecode(raw, raw_keys=[b"info"])
+
+
+def test_raw_keys_any_depth():
+    assert bdecode(b"d1:ad1:ali1eee1:bi2ee", raw_keys=[b"a"]) == {
+        b"a": BencodeRaw(b"d1:ali1eee"),
+        b"b": 2,
+    }
+
+    # nested dicts are matched too, not only the top level one
+    assert bdecode(b"ld1:ad1:bi1eeee", raw_keys=[b"b"]) == [
+        {b"a": {b"b": BencodeRaw(b"i1e")}}
+    ]
+
+
+def test_raw_keys_strict():
+    raw = b"d1:ad1:ci1e1:bi2eee"
+    with pytest.raises(BencodeDecodeError):
+        bdecode(raw, raw_keys=[b"a"])
+
+    v = bdecode(raw, raw_keys=[b"a"], strict=False)
+    assert bytes(v[b"a"]) == b"d1:ci1e1:bi2ee"
+
+    # structure is still validated
+    with pytest.raises(BencodeDecodeError):
+        bdecode(b"d1:ad1:ci1e1:bee", raw_keys=[b"a"], strict=False)
+
+
+def test_raw():
+    r = BencodeRaw(b"d1:ai1ee")
+    assert r == BencodeRaw(bytearray(b"d1:ai1ee"))
+    assert r != BencodeRaw(b"i1e")
+    assert hash(r) == hash(b"d1:ai1ee")
+    assert len(r) == 8
+    assert repr(r) == "BencodeRaw(b'd1:ai1ee')"
+
+    assert bencode([r, {"b": r}]) == b"ld1:ai1eed1:bd1:ai1eee"
+    assert bencode(r, exact_size=True) == b"d1:ai1ee"
+
+    for invalid in [b"", b"i01e", b"i1ei2e", b"d1:bi1e1:ai1ee"]:
+        with pytest.raises(BencodeDecodeError):
+            BencodeRaw(invalid)
+
+    with pytest.raises(TypeError):
+        BencodeRaw("i1e")  # type: ignore
+
+    assert bdecode(b"d1:ald1:bi1eee1:bi2ee", raw_keys=[b"a", b"b"]) == {
+        b"a": BencodeRaw(b"ld1:bi1eee"),
+        b"b": BencodeRaw(b"i2e"),
+    }
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode(b"d1:ae", raw_keys=[b"a"])
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode(b"d1:ai01ee", raw_keys=[b"a"])
@@ -0,0 +1,91 @@
+from pathlib import Path
+from typing import Any
+
+import pytest
+
+from bencode_cpp import BencodeDecodeError, LazyDict, LazyList, bdecode, bdecode_lazy
+
+fixture = Path(__file__).joinpath(
+    "../fixtures/ubuntu-22.04.2-desktop-amd64.iso.torrent.bin"
+).resolve()
+
+
+@pytest.mark.parametrize(
+    "raw",
+    [
+        b"i1e",
+        b"i-9223372036854775808e",
+        b"i18446744073709551616e",
+        b"0:",
+        b"4:spam",
+        b"le",
+        b"de",
+        b"lli1eelee",
+        b"d3:cow3:moo4:spam4:eggse",
+        b"d4:spaml1:a1:bee",
+        b"d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe",
+    ],
+)
+def test_to_python(raw: bytes):
+    v: Any = bdecode_lazy(raw)
+    if isinstance(v, (LazyDict, LazyList)):
+        v = v.to_python()
+    assert v == bdecode(raw)
+
+
+def test_lazy_dict():
+    d = bdecode_lazy(b"d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe")
+    assert isinstance(d, LazyDict)
+    assert len(d) == 4
+    assert list(d) == [b"a", b"q", b"t", b"y"]
+    assert d[b"q"] == b"ping"
+    assert b"t" in d
+    assert b"x" not in d
+    assert d.get(b"x") is None
+    assert d.get(b"x", 1) == 1
+    assert isinstance(d[b"a"], LazyDict)
+    assert d[b"a"][b"id"] == b"abcdefghij0123456789"
+    assert [k for k, _ in d.items()] == d.keys()
+
+    with pytest.raises(KeyError):
+        d[b"x"]
+
+
+def test_lazy_list():
+    v = bdecode_lazy(b"li1e4:spamli2eee")
+    assert isinstance(v, LazyList)
+    assert len(v) == 3
+    assert v[0] == 1
+    assert v[-2] == b"spam"
+    assert v[2].to_python() == [2]
+
+    with pytest.raises(IndexError):
+        v[3]
+
+
+def test_lazy_torrent():
+    raw = fixture.read_bytes()
+    d = bdecode_lazy(raw)
+    expected = bdecode(raw)
+
+    assert d[b"info"][b"name"] == expected[b"info"][b"name"]
+    assert d[b"info"][b"piece length"] == expected[b"info"][b"piece length"]
+    assert d.to_python() == expected
+
+
+@pytest.mark.parametrize(
+    "raw",
+    [
+        b"",
+        b"i-0e",
+        b"i01e",
+        b"ie",
+        b"l",
+        b"d3:foo4:spam3:bari42ee",
+        b"d1:ai1e1:ai2ee",
+        b"i1ei2e",
+    ],
+)
+def test_bad_case(raw: bytes):
+    with pytest.raises(BencodeDecodeError):
+        bdecode_lazy(raw)
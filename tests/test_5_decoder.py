@@ -0,0 +1,157 @@
+import sys
+from pathlib import Path
+
+import pytest
+
+from bencode_cpp import BencodeDecodeError, Decoder, bdecode
+
+fixture = Path(__file__).joinpath(
+    "../fixtures/ubuntu-22.04.2-desktop-amd64.iso.torrent.bin"
+).resolve()
+
+
+def test_feed_whole():
+    d = Decoder()
+    assert d.feed(b"i1e4:spamd1:ai1ee") == [1, b"spam", {b"a": 1}]
+    assert not d.pending
+
+
+@pytest.mark.parametrize("chunk_size", [1, 2, 3, 7, 64, 4096])
+def test_feed_chunks(chunk_size: int):
+    raw = fixture.read_bytes()
+    d = Decoder()
+    values = []
+    for i in range(0, len(raw), chunk_size):
+        values.extend(d.feed(raw[i : i + chunk_size]))
+        assert d.pending == (i + chunk_size < len(raw))
+
+    assert values == [bdecode(raw)]
+
+
+def test_feed_byte_by_byte():
+    raw = b"i-9223372036854775808ei18446744073709551616e0:ld3:cow3:mooee"
+    d = Decoder()
+    values = []
+    for i in range(len(raw)):
+        values.extend(d.feed(memoryview(raw)[i : i + 1]))
+
+    assert values == [
+        -9223372036854775808,
+        18446744073709551616,
+        b"",
+        [{b"cow": b"moo"}],
+    ]
+
+
+@pytest.mark.parametrize(
+    "raw",
+    [
+        b"i-0e",
+        b"i01e",
+        b"ie",
+        b"i--1e",
+        b"i1-e",
+        b"01:q",
+        b"1a2:qwer",
+        b"e",
+        b"d3:foo4:spam3:bari42ee",
+        b"d1:ai1e1:ai2ee",
+        b"di1ei2ee",
+        b"d1:ae",
+    ],
+)
+def test_bad_case(raw: bytes):
+    d = Decoder()
+    with pytest.raises(BencodeDecodeError):
+        for i in range(len(raw)):
+            d.feed(raw[i : i + 1])
+
+    # decoder is broken until reset
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"i1e")
+
+    d.reset()
+    assert d.feed(b"i1e") == [1]
+
+
+def test_max_depth():
+    d = Decoder(max_depth=2)
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"lld1:ai1eeee")
+
+    d = Decoder(max_depth=3)
+    assert d.feed(b"lld1:ai1eeee") == [[[{b"a": 1}]]]
+
+    d = Decoder()
+    with pytest.raises(BencodeDecodeError):
+        for _ in range(1001):
+            d.feed(b"l")
+
+
+def test_max_int_length():
+    d = Decoder(max_int_length=3)
+    assert d.feed(b"i-12ei123e") == [-12, 123]
+
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"i12")
+        d.feed(b"34e")
+
+    # token is never buffered without limit
+    d = Decoder()
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"i")
+        for _ in range(5):
+            d.feed(b"1" * 1000)
+
+
+def test_max_bytes_length():
+    d = Decoder(max_bytes_length=4)
+    assert d.feed(b"4:spam0:") == [b"spam", b""]
+
+    # rejected when length is parsed, before any content arrives
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"5:")
+
+    d = Decoder(max_bytes_length=4)
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"1")
+        d.feed(b"0")
+
+    d = Decoder()
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"999999999999:")
+
+
+@pytest.mark.skipif(
+    not hasattr(sys, "set_int_max_str_digits"), reason="python 3.11+ only"
+)
+def test_int_conversion_error():
+    limit = sys.get_int_max_str_digits()
+    sys.set_int_max_str_digits(1000)
+    try:
+        d = Decoder()
+        with pytest.raises(ValueError):
+            d.feed(b"i" + b"1" * 2000 + b"e")
+    finally:
+        sys.set_int_max_str_digits(limit)
+
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"i1e")
+
+
+def test_values_before_error():
+    d = Decoder()
+    assert d.feed(b"i1e4:spamli2ee") == [1, b"spam", [2]]
+
+    assert d.feed(b"i3ei4ex") == [3, 4]
+    assert d.pending
+
+    with pytest.raises(BencodeDecodeError, match="invalid bencode prefix"):
+        d.feed(b"i5e")
+
+    with pytest.raises(BencodeDecodeError):
+        d.feed(b"i5e")
+
+    d.reset()
+    assert not d.pending
+    assert d.feed(b"i5e") == [5]
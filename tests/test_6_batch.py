@@ -0,0 +1,72 @@
+from pathlib import Path
+import sys
+
+import pytest
+
+from bencode_cpp import (
+    BencodeDecodeError,
+    BencodeEncodeError,
+    bdecode,
+    bdecode_many,
+    bencode,
+    bencode_many,
+)
+
+fixture = Path(__file__).joinpath(
+    "../fixtures/ubuntu-22.04.2-desktop-amd64.iso.torrent.bin"
+).resolve()
+
+
+@pytest.mark.parametrize("workers", [0, 1, 4])
+def test_decode_many(workers: int):
+    raw = fixture.read_bytes()
+    buffers = [
+        b"d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe",
+        raw,
+        bytearray(b"li1ei18446744073709551616e4:spame"),
+    ] * 100
+
+    assert bdecode_many(buffers, workers=workers) == [bdecode(b) for b in buffers]
+
+
+def test_decode_many_errors():
+    results = bdecode_many([b"i1e", b"i01e", "str", memoryview(b"le"), b""])
+
+    assert results[0] == 1
+    assert isinstance(results[1], BencodeDecodeError)
+    assert isinstance(results[2], TypeError)
+    assert results[3] == []
+    assert isinstance(results[4], BencodeDecodeError)
+
+
+@pytest.mark.skipif(
+    not hasattr(sys, "set_int_max_str_digits"), reason="python 3.11+ only"
+)
+def test_decode_many_object_errors():
+    limit = sys.get_int_max_str_digits()
+    sys.set_int_max_str_digits(1000)
+    try:
+        results = bdecode_many([b"i1e", b"li" + b"1" * 2000 + b"ee", b"le"])
+    finally:
+        sys.set_int_max_str_digits(limit)
+
+    assert results[0] == 1
+    assert isinstance(results[1], ValueError)
+    assert results[2] == []
+
+
+def test_encode_many():
+    values = [{"a": [1, 2, b"x"]}, b"spam", 18446744073709551616] * 100
+    assert bencode_many(values) == [bencode(v) for v in values]
+
+
+def test_encode_many_errors():
+    d: dict = {}
+    d["a"] = d
+    results = bencode_many([1, None, {"a": 1, b"a": 2}, d, [b"ok"]])
+
+    assert results[0] == b"i1e"
+    assert isinstance(results[1], TypeError)
+    assert isinstance(results[2], BencodeEncodeError)
+    assert isinstance(results[3], ValueError)
+    assert results[4] == b"l2:oke"
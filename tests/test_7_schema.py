@@ -0,0 +1,144 @@
+from __future__ import annotations
+
+import dataclasses
+from typing import Any, Dict, List, Optional, TypedDict
+
+import pytest
+
+from bencode_cpp import BencodeDecodeError, Schema, bencode
+
+
+@dataclasses.dataclass
+class Peer:
+    ip: str
+    port: int
+
+
+@dataclasses.dataclass
+class Announce:
+    interval: int
+    peers: List[Peer]
+    min_interval: Optional[int] = dataclasses.field(
+        metadata={"bencode_key": "min interval"}
+    )
+    tracker_id: bytes = dataclasses.field(
+        default=b"", metadata={"bencode_key": b"tracker id"}
+    )
+
+
+class Ping(TypedDict):
+    t: bytes
+    y: str
+    a: Dict[bytes, Any]
+
+
+@dataclasses.dataclass
+class Node:
+    name: bytes
+    children: List[Node] = dataclasses.field(default_factory=list)
+
+
+def test_dataclass():
+    raw = bencode(
+        {
+            "interval": 1800,
+            "min interval": 60,
+            "peers": [{"ip": "127.0.0.1", "port": 6881, "peer id": b"x" * 20}],
+            "complete": 5,
+            "incomplete": [1, {"nested": "ignored"}],
+        }
+    )
+
+    assert Schema(Announce).decode(raw) == Announce(
+        interval=1800,
+        min_interval=60,
+        peers=[Peer(ip="127.0.0.1", port=6881)],
+    )
+
+
+def test_missing_keys():
+    s = Schema(Announce)
+    assert s.decode(b"d8:intervali1e5:peerslee") == Announce(
+        interval=1, peers=[], min_interval=None
+    )
+
+    with pytest.raises(BencodeDecodeError):
+        s.decode(b"d5:peerslee")
+
+
+def test_typed_dict():
+    raw = b"d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe"
+    assert Schema(Ping).decode(raw) == {
+        "a": {b"id": b"abcdefghij0123456789"},
+        "t": b"aa",
+        "y": "q",
+    }
+
+
+def test_recursive():
+    raw = bencode(
+        {"name": b"a", "children": [{"name": b"b"}, {"name": b"c", "children": []}]}
+    )
+    assert Schema(Node).decode(raw) == Node(b"a", [Node(b"b"), Node(b"c")])
+
+
+def test_container_types():
+    assert Schema(List[int]).decode(b"li1ei2ee") == [1, 2]
+    assert Schema(Dict[str, str]).decode(b"d1:a1:be") == {"a": "b"}
+    assert Schema(int).decode(b"i18446744073709551616e") == 18446744073709551616
+
+
+def test_invalid():
+    with pytest.raises(BencodeDecodeError):
+        Schema(Peer).decode(b"d2:ipi1e4:porti1ee")
+
+    with pytest.raises(BencodeDecodeError):
+        Schema(Peer).decode(b"d4:porti1e2:ip1:xe")
+
+    # unknown keys are still validated
+    with pytest.raises(BencodeDecodeError):
+        Schema(Peer).decode(b"d1:ai01e2:ip1:x4:porti1ee")
+
+    with pytest.raises(UnicodeDecodeError):
+        Schema(Peer).decode(b"d2:ip1:\xff4:porti1ee")
+
+
+def test_unsupported_type():
+    with pytest.raises(TypeError):
+        Schema(float)
+
+    with pytest.raises(TypeError):
+        Schema(Dict[int, int])
+
+
+def test_max_depth():
+    s = Schema(List[List[Any]])
+    assert s.decode(b"llli1eeee", max_depth=4) == [[[[1]]]]
+
+    with pytest.raises(BencodeDecodeError):
+        s.decode(b"llli1eeee", max_depth=3)
+
+    with pytest.raises(BencodeDecodeError):
+        s.decode(b"lllei1ee", max_depth=2)
+
+    # recursive schema can't nest deeper than the limit
+    raw = b"d8:childrenl" * 400 + b"d4:name0:e" + b"e4:name0:e" * 400
+    with pytest.raises(BencodeDecodeError):
+        Schema(Node).decode(raw, max_depth=800)
+
+    node = Schema(Node).decode(raw)
+    for _ in range(400):
+        (node,) = node.children
+    assert node == Node(name=b"")
+
+    # schema types are decoded with recursion, larger max_depth doesn't lift the limit
+    raw = b"d8:childrenl" * 1000 + b"d4:name0:e" + b"e4:name0:e" * 1000
+    with pytest.raises(BencodeDecodeError):
+        Schema(Node).decode(raw, max_depth=10**6)
+
+    # Any values are decoded without recursion
+    depth = 100000
+    v = Schema(List[Any]).decode(b"l" * depth + b"e" * depth, max_depth=depth)
+    for _ in range(depth - 1):
+        (v,) = v
+    assert v == []
@@ -0,0 +1,52 @@
+import os
+
+import pytest
+
+from bencode_cpp import (
+    BencodeDecodeError,
+    bdecode,
+    bencode,
+    bencode_into,
+    reset_stats,
+    stats,
+)
+
+
+def test_stats():
+    reset_stats()
+    s = stats()
+    if not s:
+        # CI builds with it enabled, make sure stats tests are not skipped there
+        if os.environ.get("BENCODE_CPP_STATS") == "1":
+            pytest.fail("BENCODE_CPP_STATS is set but extension is built without it")
+        pytest.skip("built without BENCODE_CPP_STATS")
+
+    assert set(s.values()) == {0}
+
+    raw = bencode({"a": [2**100, b"x" * 10000]})
+    assert bdecode(raw) == {b"a": [2**100, b"x" * 10000]}
+
+    with pytest.raises(BencodeDecodeError):
+        bdecode(b"i1")
+
+    with pytest.raises(TypeError):
+        bencode(None)
+
+    with pytest.raises(ValueError):
+        bencode_into(b"spam", bytearray(2))
+
+    s = stats()
+    assert s["encode_calls"] == 3
+    assert s["decode_calls"] == 2
+    assert s["bytes_in"] == len(raw) + 2
+    assert s["bytes_out"] >= len(raw)
+    assert s["pool_hits"] + s["pool_misses"] == 2
+    assert "buffer_grows" in s
+    assert s["encode_big_ints"] == 1
+    assert s["decode_big_ints"] == 1
+    assert s["decode_errors"] == 1
+    assert s["type_errors"] == 1
+    assert s["value_errors"] == 1
+
+    reset_stats()
+    assert set(stats().values()) == {0}